@@ -0,0 +1,166 @@
+#pragma once
+#include "stdafx.h"
+#include "LargeBuffer.hpp"
+
+//Bump allocator handing out runs of T from large chunks. Runs are not freed one by one, everything goes with
+//the arena, but a run handed back with release is kept on a free list for its size and given out again by
+//allocate_reused, for lists that grow one item at a time. Threads bump the current chunk with an atomic add and only lock to start a new chunk.
+//Chunks are LargeBuffers and T is left unconstructed, so it has to be a plain struct. They start small and
+//double up to kChunkItems, so a small graph does not pay for faulting in a huge page. A few full chunks of a
+//dropped arena are kept as spares of the thread that dropped it, so the next job of a batch worker takes
+//memory that is already mapped and faulted in.
+template <typename T>
+class Arena {
+public:
+  Arena() : current(nullptr), next_chunk_items(kFirstChunkItems) {}
+
+  ~Arena() {
+    auto& spare = SpareChunks();
+    for (auto& chunk : chunks) {
+      if (chunk->size == kChunkItems && spare.size() < kMaxSpareChunks) {
+        spare.push_back(std::move(chunk->memory));
+      }
+    }
+  }
+
+  T* allocate(size_t count) {
+    for (;;) {
+      Chunk* chunk = current.load(std::memory_order_acquire);
+      if (chunk != nullptr) {
+        size_t start = chunk->used.fetch_add(count);
+        if (start + count <= chunk->size) {
+          return chunk->items + start;
+        }
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      if (current.load() == chunk) {
+        //a run that does not fit a chunk gets one of its own, the current chunk stays in use
+        if (count > kChunkItems / 4) {
+          chunks.emplace_back(new Chunk(count));
+          chunks.back()->used = count;
+          return chunks.back()->items;
+        }
+        size_t size = count > next_chunk_items ? count : next_chunk_items;
+        auto& spare = SpareChunks();
+        if (size == kChunkItems && !spare.empty()) {
+          chunks.emplace_back(new Chunk(std::move(spare.back()), size));
+          spare.pop_back();
+        }
+        else {
+          chunks.emplace_back(new Chunk(size));
+        }
+        next_chunk_items = next_chunk_items < kChunkItems / 2 ? 2 * next_chunk_items : (size_t)kChunkItems;
+        current.store(chunks.back().get(), std::memory_order_release);
+      }
+    }
+  }
+
+  //a released run of count items if there is one, otherwise a new one
+  T* allocate_reused(size_t count) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found = free_runs.find(count);
+      if (found != free_runs.end() && found->second != nullptr) {
+        T* run = found->second;
+        std::memcpy(&found->second, run, sizeof(T*));
+        return run;
+      }
+    }
+    return allocate(count);
+  }
+
+  //Puts a run of count items that is no longer used on the free list of its size, the link to the next one
+  //is kept in the run itself. Runs too small to hold it are left behind.
+  void release(T* run, size_t count) {
+    if (count * sizeof(T) < sizeof(T*)) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    T*& head = free_runs[count];
+    std::memcpy(run, &head, sizeof(T*));
+    head = run;
+  }
+
+private:
+  static const size_t kFirstChunkItems = 1 << 12;
+  static const size_t kChunkItems = 1 << 20;
+  static const size_t kMaxSpareChunks = 4;
+
+  struct Chunk {
+    LargeBuffer memory;
+    T* items;
+    size_t size;
+    std::atomic<size_t> used;
+
+    explicit Chunk(size_t size) : memory(size * sizeof(T)), items((T*)memory.get()), size(size), used(0) {}
+    Chunk(LargeBuffer&& spare, size_t size) : memory(std::move(spare)), items((T*)memory.get()), size(size), used(0) {}
+  };
+
+  static std::vector<LargeBuffer>& SpareChunks() {
+    static thread_local std::vector<LargeBuffer> spare;
+    return spare;
+  }
+
+  std::vector<std::unique_ptr<Chunk>> chunks;
+  std::atomic<Chunk*> current;
+  std::mutex mutex;
+  size_t next_chunk_items;
+  std::map<size_t, T*> free_runs;
+};
+
+//Adjacency list living in an Arena. It grows by moving to a run twice as long and hands the old one back to
+//the arena, where the next list growing to that size takes it. Lists that are reserved at their final size
+//up front never move. SizeT holds the length and capacity,
+//a 32 bit one keeps the list at 16 bytes.
+template <typename T, typename SizeT = size_t>
+class ArenaList {
+public:
+  ArenaList() : items(nullptr), count(0), capacity(0) {}
+
+  T* begin() const { return items; }
+  T* end() const { return items + count; }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T& operator[](size_t i) const { return items[i]; }
+
+  void reserve(Arena<T>& arena, size_t new_capacity) {
+    if (new_capacity <= (size_t)capacity) {
+      return;
+    }
+    T* run = arena.allocate(new_capacity);
+    std::copy(items, items + count, run);
+    items = run;
+    capacity = (SizeT)new_capacity;
+  }
+
+  //reserve() for lists carved out of one shared run
+  void assign_run(T* run, size_t run_capacity) {
+    items = run;
+    count = 0;
+    capacity = (SizeT)run_capacity;
+  }
+
+  //drops the items from new_count on, their room stays with the list
+  void truncate(size_t new_count) {
+    count = (SizeT)new_count;
+  }
+
+  void push_back(Arena<T>& arena, const T& item) {
+    if (count == capacity) {
+      size_t new_capacity = capacity < 4 ? 4 : 2 * (size_t)capacity;
+      T* run = arena.allocate_reused(new_capacity);
+      std::copy(items, items + count, run);
+      if (items != nullptr) {
+        arena.release(items, capacity);
+      }
+      items = run;
+      capacity = (SizeT)new_capacity;
+    }
+    items[count++] = item;
+  }
+
+private:
+  T* items;
+  SizeT count;
+  SizeT capacity;
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+
+//Splits a job line into its arguments at whitespace.
+inline std::vector<std::string> SplitArgs(const std::string& line) {
+  std::vector<std::string> args;
+  std::stringstream in(line);
+  std::string arg;
+  while (in >> arg) {
+    args.push_back(arg);
+  }
+  return args;
+}
+
+//Values of the first {..} group of text: {a,b,c} lists them, {lo..hi} counts from lo to hi. False with the
+//reason in error for a range that is not one, the caller reports it.
+inline bool SweepValues(const std::string& group, std::vector<std::string>& values, std::string& error) {
+  size_t dots = group.find("..");
+  if (dots != std::string::npos) {
+    long long low, high;
+    std::stringstream low_in(group.substr(0, dots));
+    std::stringstream high_in(group.substr(dots + 2));
+    if (!(low_in >> low) || !(high_in >> high) || low > high) {
+      error = "Invalid sweep range: {" + group + "}";
+      return false;
+    }
+    for (long long v = low; v <= high; ++v) {
+      values.push_back(std::to_string(v));
+    }
+    return true;
+  }
+  std::stringstream in(group);
+  std::string value;
+  while (std::getline(in, value, ',')) {
+    values.push_back(value);
+  }
+  return true;
+}
+
+//Expands every {..} group of a job line into one job per combination of values, the first group varying
+//slowest, and adds them to jobs. "-t random -n {1000,2000} -s {1..3}" is six jobs. False with the reason in
+//error for a line that does not expand.
+inline bool ExpandSweep(const std::string& line, std::vector<std::vector<std::string>>& jobs, std::string& error) {
+  size_t open = line.find('{');
+  if (open == std::string::npos) {
+    std::vector<std::string> args = SplitArgs(line);
+    if (!args.empty()) {
+      jobs.push_back(args);
+    }
+    return true;
+  }
+  size_t close = line.find('}', open);
+  if (close == std::string::npos) {
+    error = "Unclosed sweep group: " + line;
+    return false;
+  }
+  std::vector<std::string> values;
+  if (!SweepValues(line.substr(open + 1, close - open - 1), values, error)) {
+    return false;
+  }
+  for (auto& value : values) {
+    if (!ExpandSweep(line.substr(0, open) + value + line.substr(close + 1), jobs, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//Value given to option `name`, long or short and without dashes, in the arguments of a job as `options`
+//parse them, "1" for a flag and empty if it is not set. -n 10 and --nodes=10 give the same value.
+inline std::string JobOption(cxxopts::Options& options, const std::vector<std::string>& args, const std::string& name) {
+  std::string long_name = name;
+  bool flag = false;
+  for (auto& group : options.groups()) {
+    for (auto& option : options.group_help(group).options) {
+      if (option.s == name || option.l == name) {
+        long_name = option.l;
+        flag = option.is_boolean;
+      }
+    }
+  }
+  std::vector<const char*> argv(1, "GraphGen");
+  for (auto& arg : args) {
+    argv.push_back(arg.c_str());
+  }
+  int argc = (int)argv.size();
+  const char** parsed = argv.data();
+  auto result = options.parse(argc, parsed);
+  std::string value;
+  for (auto& argument : result.arguments()) {
+    if (argument.key() == long_name) {
+      value = flag ? "1" : argument.value();
+    }
+  }
+  return value;
+}
+
+//Output file of a job: {job} in the template becomes the number of the job, any other {name} the value of
+//option name in the job.
+inline std::string JobOutputName(cxxopts::Options& options, const std::string& pattern, const std::vector<std::string>& args, size_t job) {
+  std::string name;
+  size_t at = 0;
+  while (at < pattern.size()) {
+    size_t open = pattern.find('{', at);
+    size_t close = open == std::string::npos ? open : pattern.find('}', open);
+    if (close == std::string::npos) {
+      name += pattern.substr(at);
+      break;
+    }
+    name += pattern.substr(at, open - at);
+    std::string key = pattern.substr(open + 1, close - open - 1);
+    name += key == "job" ? std::to_string(job) : JobOption(options, args, key);
+    at = close + 1;
+  }
+  return name;
+}
+
+//Runs run(job) for every job on NumThreads() workers, each taking the next job when it is done with one. The
+//parallel loops of a job run serially on its worker, jobs are what runs in parallel. A worker runs its jobs
+//one after the other, so run has to start every job from the default settings, and the buffers a worker
+//keeps for its thread, like the spare arena chunks, are reused by its next job.
+template <typename F>
+void RunBatch(size_t num_jobs, F run) {
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < NumThreads(); ++t) {
+    workers.emplace_back([&]() {
+      ThreadPool::InLoop() = true;
+      for (size_t job = next++; job < num_jobs; job = next++) {
+        run(job);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
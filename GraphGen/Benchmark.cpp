@@ -0,0 +1,54 @@
+#include "stdafx.h"
+#include "Benchmark.hpp"
+
+#ifdef GRAPHGEN_COUNT_ALLOCATIONS
+//Global operator new and delete are replaced to count the allocations for --benchmark, only in builds with
+//GRAPHGEN_COUNT_ALLOCATIONS defined so the others allocate at full speed. They are defined here rather than in
+//a header, the compiler must not see them when it inlines new and delete elsewhere.
+//GCC takes a pointer from the replaced new that reaches free() here for a mismatch
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+//on cache lines of their own, so bumping one does not stall the threads bumping the other
+alignas(64) static std::atomic<long long> allocation_count(0);
+alignas(64) static std::atomic<long long> allocated_bytes(0);
+
+long long AllocationCount() {
+  return allocation_count.load(std::memory_order_relaxed);
+}
+
+long long AllocatedBytes() {
+  return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  std::free(p);
+}
+#endif
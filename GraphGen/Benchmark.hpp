@@ -0,0 +1,147 @@
+#pragma once
+#include "stdafx.h"
+
+#ifdef GRAPHGEN_COUNT_ALLOCATIONS
+//Allocations through operator new since the start, counted by the replacements in Benchmark.cpp.
+long long AllocationCount();
+long long AllocatedBytes();
+#endif
+
+//Result of one benchmark case, the generation and the writing of one graph. The allocations are -1 in
+//builds that do not count them.
+struct BenchmarkResult {
+  std::string name;
+  long long edges = 0;
+  long long bytes = 0;
+  double seconds = 0;
+  long long peak_rss_bytes = 0;
+  long long allocations = -1;
+  long long allocated_bytes = -1;
+};
+
+#ifdef __linux__
+//Output sink that only counts the bytes and lines written to it, so the writers run at full speed without
+//a disk or a pipe in the measurement.
+struct CountingSink {
+  long long bytes = 0;
+  long long lines = 0;
+
+  static ssize_t write(void* cookie, const char* data, size_t size) {
+    CountingSink& sink = *(CountingSink*)cookie;
+    sink.bytes += size;
+    sink.lines += std::count(data, data + size, '\n');
+    return size;
+  }
+
+  std::FILE* open() {
+    cookie_io_functions_t functions;
+    std::memset(&functions, 0, sizeof(functions));
+    functions.write = &CountingSink::write;
+    std::FILE* file = fopencookie(this, "w", functions);
+    std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    return file;
+  }
+};
+
+//Restarts the peak resident set size of the process, false where the kernel does not allow it.
+inline bool ResetPeakRss() {
+  std::ofstream clear("/proc/self/clear_refs");
+  clear << "5";
+  clear.flush();
+  return (bool)clear;
+}
+
+inline long long PeakRssBytes() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line)) {
+    if (line.compare(0, 6, "VmHWM:") == 0) {
+      return std::stoll(line.substr(6)) * 1024;
+    }
+  }
+  return 0;
+}
+#endif
+
+//Text as a JSON string, quotes included.
+inline std::string JsonString(const std::string& text) {
+  std::string quoted = "\"";
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    }
+    else if ((unsigned char)c < 0x20) {
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    }
+    else {
+      quoted += c;
+    }
+  }
+  return quoted + "\"";
+}
+
+//Writes the results as JSON, one case per line so a baseline can be read back without a JSON parser.
+inline void WriteBenchmarkJson(std::ostream& out, const std::vector<BenchmarkResult>& results, unsigned threads) {
+  out << "{\"threads\": " << threads << ", \"cases\": [" << std::endl;
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchmarkResult& r = results[i];
+    double seconds = std::max(r.seconds, 1e-9);
+    out << "{\"case\": " << JsonString(r.name) << ", \"edges\": " << r.edges << ", \"bytes\": " << r.bytes << ", \"seconds\": " << r.seconds
+        << ", \"edges_per_second\": " << (long long)(r.edges / seconds) << ", \"bytes_per_second\": " << (long long)(r.bytes / seconds)
+        << ", \"peak_rss_bytes\": " << r.peak_rss_bytes;
+    if (r.allocations >= 0) {
+      out << ", \"allocations\": " << r.allocations << ", \"allocated_bytes\": " << r.allocated_bytes;
+    }
+    out << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  out << "]}" << std::endl;
+}
+
+//Number after "key": on a line written by WriteBenchmarkJson, or -1.
+inline double JsonNumber(const std::string& line, const std::string& key) {
+  size_t at = line.find("\"" + key + "\": ");
+  if (at == std::string::npos) {
+    return -1;
+  }
+  return std::atof(line.c_str() + at + key.size() + 4);
+}
+
+//Compares the results with a baseline written by an earlier run, printing the ratio of time, peak memory
+//and allocations of every case found in both. Ratios above 1 mean the current build is slower or bigger,
+//a ratio of 0 that one of the runs did not measure it. False if the baseline cannot be read.
+inline bool CompareBenchmark(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::string& baseline_path) {
+  std::ifstream in(baseline_path);
+  if (!in) {
+    return false;
+  }
+  //keyed by the quoted name as written, escapes and all
+  std::map<std::string, std::string> baseline;
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t at = line.find("{\"case\": \"");
+    if (at != std::string::npos) {
+      size_t start = at + 9;
+      size_t end = start + 1;
+      while (end < line.size() && line[end] != '"') {
+        end += line[end] == '\\' ? 2 : 1;
+      }
+      baseline[line.substr(start, end + 1 - start)] = line;
+    }
+  }
+  out << "time  memory  allocations  case" << std::endl;
+  for (auto& r : results) {
+    auto it = baseline.find(JsonString(r.name));
+    if (it == baseline.end()) {
+      continue;
+    }
+    auto ratio = [](double now, double before) { return now >= 0 && before > 0 ? now / before : 0; };
+    char text[64];
+    std::snprintf(text, sizeof(text), "%4.2f  %6.2f  %11.2f  ", ratio(r.seconds, JsonNumber(it->second, "seconds")),
+      ratio((double)r.peak_rss_bytes, JsonNumber(it->second, "peak_rss_bytes")), ratio((double)r.allocations, JsonNumber(it->second, "allocations")));
+    out << text << r.name << std::endl;
+  }
+  return true;
+}
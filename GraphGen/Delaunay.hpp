@@ -0,0 +1,321 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+
+//Signed 128 bit integer, just enough for the exact in-circle test.
+struct Wide {
+  unsigned long long lo;
+  long long hi;
+
+  static Wide Multiply(long long a, long long b) {
+    unsigned long long ua = a < 0 ? 0 - (unsigned long long)a : (unsigned long long)a;
+    unsigned long long ub = b < 0 ? 0 - (unsigned long long)b : (unsigned long long)b;
+    unsigned long long a_lo = ua & 0xffffffffu;
+    unsigned long long a_hi = ua >> 32;
+    unsigned long long b_lo = ub & 0xffffffffu;
+    unsigned long long b_hi = ub >> 32;
+    unsigned long long low = a_lo * b_lo;
+    unsigned long long mid1 = a_hi * b_lo;
+    unsigned long long mid2 = a_lo * b_hi;
+    unsigned long long carry = ((low >> 32) + (mid1 & 0xffffffffu) + (mid2 & 0xffffffffu)) >> 32;
+    Wide w;
+    w.lo = low + (mid1 << 32) + (mid2 << 32);
+    w.hi = (long long)(a_hi * b_hi + (mid1 >> 32) + (mid2 >> 32) + carry);
+    if ((a < 0) != (b < 0)) {
+      w.lo = ~w.lo + 1;
+      w.hi = ~w.hi + (w.lo == 0 ? 1 : 0);
+    }
+    return w;
+  }
+
+  Wide operator+(const Wide& other) const {
+    Wide w;
+    w.lo = lo + other.lo;
+    w.hi = hi + other.hi + (w.lo < lo ? 1 : 0);
+    return w;
+  }
+
+  bool positive() const {
+    return hi > 0 || (hi == 0 && lo > 0);
+  }
+};
+
+//Delaunay triangulation of points with distinct integer coordinates below 2^20, by the divide and conquer
+//algorithm of Guibas & Stolfi on quad-edges. The upper recursion levels are split up front, their leaves are
+//triangulated as the blocks of a parallel loop, each allocating from its own pool, and then merged level by
+//level, the merges of a level in parallel as well.
+class Delaunay {
+public:
+  struct Point {
+    long long x;
+    long long y;
+    int id;
+
+    bool operator<(const Point& other) const {
+      return std::tie(x, y, id) < std::tie(other.x, other.y, other.id);
+    }
+  };
+
+  //points must be sorted and free of duplicates, returns the edges as pairs of point ids
+  static std::vector<std::pair<int, int>> Triangulate(const std::vector<Point>& points) {
+    Delaunay d(points);
+    std::vector<std::pair<int, int>> edges;
+    if (points.size() < 2) {
+      return edges;
+    }
+    //inside a loop, a batch job for one, the parallel loops run serially and splitting only costs
+    int max_depth = 0;
+    while (!ThreadPool::InLoop() && (1u << max_depth) < NumThreads()) {
+      max_depth++;
+    }
+    d.triangulate(max_depth);
+    for (auto& pool : d.pools) {
+      for (size_t c = 0; c < pool->chunks.size(); ++c) {
+        int used = c + 1 == pool->chunks.size() ? pool->used : kChunkEdges;
+        for (int i = 0; i < used; ++i) {
+          Quad* e = &pool->chunks[c][4 * i];
+          if (e->p >= 0 && e->r()->p >= 0) {
+            edges.emplace_back(points[e->p].id, points[e->r()->p].id);
+          }
+        }
+      }
+    }
+    return edges;
+  }
+
+private:
+  static const int kChunkEdges = 1 << 12;
+  static const int kParallelSize = 1 << 15;
+
+  struct Quad {
+    Quad* rot;
+    Quad* o;
+    int p;
+
+    Quad* r() { return rot->rot; }
+    Quad* prev() { return rot->o->rot; }
+    Quad* next() { return r()->prev(); }
+  };
+
+  struct Pool {
+    std::vector<std::unique_ptr<Quad[]>> chunks;
+    int used = kChunkEdges;
+    Quad* free = nullptr;
+  };
+
+  //Range of points of an upper recursion level, a leaf or the merge of the ranges left and right. A left half
+  //gets a pool of its own, a right half shares the one of the range it was split from, like the serial
+  //recursion, so no two ranges of a level use the same pool.
+  struct Range {
+    int lo;
+    int hi;
+    int left;
+    int right;
+    Pool* pool;
+    std::pair<Quad*, Quad*> hull;
+  };
+
+  const std::vector<Point>& pts;
+  std::vector<std::unique_ptr<Pool>> pools;
+  std::mutex pools_mutex;
+
+  explicit Delaunay(const std::vector<Point>& points) : pts(points) {}
+
+  Pool& new_pool() {
+    std::lock_guard<std::mutex> lock(pools_mutex);
+    pools.emplace_back(new Pool());
+    return *pools.back();
+  }
+
+  long long cross(int p, int a, int b) const {
+    return (pts[a].x - pts[p].x) * (pts[b].y - pts[p].y) - (pts[a].y - pts[p].y) * (pts[b].x - pts[p].x);
+  }
+
+  //is p strictly inside the circle through a, b and c
+  bool in_circle(int p, int a, int b, int c) const {
+    long long ax = pts[a].x - pts[p].x, ay = pts[a].y - pts[p].y;
+    long long bx = pts[b].x - pts[p].x, by = pts[b].y - pts[p].y;
+    long long cx = pts[c].x - pts[p].x, cy = pts[c].y - pts[p].y;
+    //floating point first, exact only when the result is within rounding error of zero
+    double a2 = (double)(ax * ax + ay * ay);
+    double b2 = (double)(bx * bx + by * by);
+    double c2 = (double)(cx * cx + cy * cy);
+    double bc = (double)(bx * cy - cx * by);
+    double ca = (double)(cx * ay - ax * cy);
+    double ab = (double)(ax * by - bx * ay);
+    double approx = a2 * bc + b2 * ca + c2 * ab;
+    double bound = 1e-12 * (a2 * std::fabs(bc) + b2 * std::fabs(ca) + c2 * std::fabs(ab));
+    if (approx > bound || approx < -bound) {
+      return approx > 0;
+    }
+    Wide det = Wide::Multiply(ax * ax + ay * ay, bx * cy - cx * by)
+      + Wide::Multiply(bx * bx + by * by, cx * ay - ax * cy)
+      + Wide::Multiply(cx * cx + cy * cy, ax * by - bx * ay);
+    return det.positive();
+  }
+
+  static Quad* make_edge(Pool& pool, int orig, int dest) {
+    Quad* r = pool.free;
+    if (r != nullptr) {
+      pool.free = r->o;
+    }
+    else {
+      if (pool.used == kChunkEdges) {
+        pool.chunks.emplace_back(new Quad[4 * kChunkEdges]);
+        pool.used = 0;
+      }
+      r = &pool.chunks.back()[4 * pool.used++];
+      for (int i = 0; i < 4; ++i) {
+        r[i].rot = &r[(i + 1) % 4];
+      }
+    }
+    for (int i = 0; i < 4; ++i) {
+      r = r->rot;
+      r->p = -1;
+      r->o = (i & 1) ? r : r->r();
+    }
+    r->p = orig;
+    r->r()->p = dest;
+    return r;
+  }
+
+  static void splice(Quad* a, Quad* b) {
+    std::swap(a->o->rot->o, b->o->rot->o);
+    std::swap(a->o, b->o);
+  }
+
+  static Quad* connect(Pool& pool, Quad* a, Quad* b) {
+    Quad* q = make_edge(pool, a->r()->p, b->p);
+    splice(q, a->next());
+    splice(q->r(), b);
+    return q;
+  }
+
+  static void remove(Pool& pool, Quad* e) {
+    splice(e, e->prev());
+    splice(e->r(), e->r()->prev());
+    e->p = -1;
+    e->r()->p = -1;
+    e->o = pool.free;
+    pool.free = e;
+  }
+
+  //Splits the ranges of the first max_depth levels in two while they are larger than kParallelSize,
+  //triangulates the leaves in parallel and merges the halves back from the deepest level up.
+  void triangulate(int max_depth) {
+    std::vector<Range> ranges(1, Range{ 0, (int)pts.size(), -1, -1, &new_pool(), {} });
+    std::vector<std::vector<int>> levels(1, std::vector<int>(1, 0));
+    std::vector<int> leaves;
+    for (int depth = 0; !levels.back().empty(); ++depth) {
+      std::vector<int> next;
+      for (int r : levels.back()) {
+        int size = ranges[r].hi - ranges[r].lo;
+        if (depth == max_depth || size <= kParallelSize) {
+          leaves.push_back(r);
+          continue;
+        }
+        int middle = ranges[r].hi - size / 2;
+        Range left{ ranges[r].lo, middle, -1, -1, &new_pool(), {} };
+        Range right{ middle, ranges[r].hi, -1, -1, ranges[r].pool, {} };
+        ranges[r].left = (int)ranges.size();
+        ranges[r].right = (int)ranges.size() + 1;
+        next.push_back(ranges[r].left);
+        next.push_back(ranges[r].right);
+        ranges.push_back(left);
+        ranges.push_back(right);
+      }
+      levels.push_back(next);
+    }
+    ParallelFor(0, leaves.size(), 1, [&](long long i, long long, long long) {
+      Range& leaf = ranges[leaves[i]];
+      leaf.hull = recurse(leaf.lo, leaf.hi, *leaf.pool);
+    });
+    for (size_t level = levels.size(); level-- > 0;) {
+      ParallelFor(0, levels[level].size(), 1, [&](long long i, long long, long long) {
+        Range& range = ranges[levels[level][i]];
+        if (range.left >= 0) {
+          range.hull = merge(ranges[range.left].hull, ranges[range.right].hull, *range.pool);
+        }
+      });
+    }
+  }
+
+  //returns the counterclockwise convex hull edge out of the leftmost point and the clockwise one out of the rightmost
+  std::pair<Quad*, Quad*> recurse(int lo, int hi, Pool& pool) {
+    int size = hi - lo;
+    if (size <= 3) {
+      Quad* a = make_edge(pool, lo, lo + 1);
+      if (size == 2) {
+        return std::make_pair(a, a->r());
+      }
+      Quad* b = make_edge(pool, lo + 1, lo + 2);
+      splice(a->r(), b);
+      long long side = cross(lo, lo + 1, lo + 2);
+      Quad* c = side != 0 ? connect(pool, b, a) : nullptr;
+      return std::make_pair(side < 0 ? c->r() : a, side < 0 ? c : b->r());
+    }
+
+    int middle = hi - size / 2;
+    std::pair<Quad*, Quad*> left = recurse(lo, middle, pool);
+    std::pair<Quad*, Quad*> right = recurse(middle, hi, pool);
+    return merge(left, right, pool);
+  }
+
+  //joins the triangulations of two neighbouring ranges along their common tangents, returns the hull edges of both
+  std::pair<Quad*, Quad*> merge(std::pair<Quad*, Quad*> left, std::pair<Quad*, Quad*> right, Pool& pool) {
+    Quad* ra = left.first;
+    Quad* A = left.second;
+    Quad* B = right.first;
+    Quad* rb = right.second;
+
+    //lower common tangent
+    for (;;) {
+      if (cross(B->p, A->r()->p, A->p) < 0) {
+        A = A->next();
+      }
+      else if (cross(A->p, B->r()->p, B->p) > 0) {
+        B = B->r()->o;
+      }
+      else {
+        break;
+      }
+    }
+    Quad* base = connect(pool, B->r(), A);
+    if (A->p == ra->p) {
+      ra = base->r();
+    }
+    if (B->p == rb->p) {
+      rb = base;
+    }
+
+    auto valid = [&](Quad* e) { return cross(e->r()->p, base->r()->p, base->p) > 0; };
+    for (;;) {
+      Quad* lc = base->r()->o;
+      if (valid(lc)) {
+        while (in_circle(lc->o->r()->p, base->r()->p, base->p, lc->r()->p)) {
+          Quad* t = lc->o;
+          remove(pool, lc);
+          lc = t;
+        }
+      }
+      Quad* rc = base->prev();
+      if (valid(rc)) {
+        while (in_circle(rc->prev()->r()->p, base->r()->p, base->p, rc->r()->p)) {
+          Quad* t = rc->prev();
+          remove(pool, rc);
+          rc = t;
+        }
+      }
+      if (!valid(lc) && !valid(rc)) {
+        break;
+      }
+      if (!valid(lc) || (valid(rc) && in_circle(rc->r()->p, rc->p, lc->r()->p, lc->p))) {
+        base = connect(pool, rc, base->r());
+      }
+      else {
+        base = connect(pool, base->r(), lc->r());
+      }
+    }
+    return std::make_pair(ra, rb);
+  }
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include "stdafx.h"
+
+template <typename Node>
+struct Edge {
+  Node source;
+  Node dest;
+  int cost;
+};
+
+//Lazy input range over the edges of a generator, one edge is drawn per step of an iterator. Cursor holds
+//the state of the generator between two edges, the block, row and skip position it is at and its engines,
+//and cursor.next(edge) draws the next edge, false after the last. Every iterator walks with a copy of the
+//first cursor, so iterators are independent and the range can be walked any number of times. A cursor is
+//O(1) besides the read-only data it shares with its copies, so a consumer can load the edges into its own
+//structures, or stop early, without a Graph ever being built. The same seed gives the same edges in the
+//same order as the blocks of the generator.
+//
+//  for (auto& edge : RandomEdgeRange<int>(n, engine, true, p, 1, 100)) {
+//    loader.add(edge.source, edge.dest, edge.cost);
+//  }
+//
+//Ranges exist for the generators that decide every edge from its position and a block's engine alone:
+//random, grid, Chung-Lu, stochastic block, bipartite without --bipartite_no_isolated and lattice. The
+//others need the whole graph, or O(n) state, before they know their first edge. The growth models
+//(scalefree, holmekim, forestfire, copying) pick targets by the degrees so far, smallworld redraws a
+//rewired link that hits a current edge, configuration and regular shuffle all stubs, csrandom keeps an
+//edge set, geometric, hyperbolic and planar place every point first, and the no_isolated pass of
+//bipartite needs to know every right node left uncovered.
+template <typename Node, typename Cursor>
+class EdgeRange {
+public:
+  explicit EdgeRange(Cursor first) : first(first) {}
+
+  class iterator {
+  public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef Edge<Node> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const Edge<Node>* pointer;
+    typedef const Edge<Node>& reference;
+
+    iterator() : done(true), count(0) {}
+    explicit iterator(const Cursor& start) : cursor(start), count(0) {
+      done = !cursor.next(edge);
+    }
+
+    reference operator*() const { return edge; }
+    pointer operator->() const { return &edge; }
+
+    iterator& operator++() {
+      done = !cursor.next(edge);
+      count++;
+      return *this;
+    }
+
+    bool operator==(const iterator& other) const { return done == other.done && (done || count == other.count); }
+    bool operator!=(const iterator& other) const { return !(*this == other); }
+
+  private:
+    Cursor cursor;
+    Edge<Node> edge;
+    bool done;
+    long long count;
+  };
+
+  iterator begin() const {
+    return iterator(first);
+  }
+
+  iterator end() const {
+    return iterator();
+  }
+
+private:
+  Cursor first;
+};
+
+template <typename Node, typename Cursor>
+EdgeRange<Node, Cursor> MakeEdgeRange(Cursor first) {
+  return EdgeRange<Node, Cursor>(first);
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+
+//Set of (source, dest) pairs for generators that draw edges at random and have to reject repeats. Pairs sit
+//in an open addressing table with linear probing, at most half full, unless an n*n bit matrix is smaller,
+//which it is once the expected pairs fill more than about 1/128 of the matrix with 32 bit ids.
+template <typename Node>
+class EdgeSet {
+public:
+  EdgeSet(Node n, size_t expected) : n(n), count(0), mask(0) {
+    size_t slots = 16;
+    while (slots < 2 * expected) {
+      slots *= 2;
+    }
+    if ((double)n * n / 8 <= (double)slots * sizeof(Key)) {
+      matrix.resize((size_t)n * n, false);
+    }
+    else {
+      table.assign(slots, empty_key());
+      mask = slots - 1;
+    }
+  }
+
+  size_t size() const {
+    return count;
+  }
+
+  //returns false if the pair is already in the set
+  bool insert(Node source, Node dest) {
+    if (!matrix.empty()) {
+      size_t index = (size_t)source * n + dest;
+      if (matrix[index]) {
+        return false;
+      }
+      matrix[index] = true;
+      count++;
+      return true;
+    }
+    if (2 * (count + 1) > table.size()) {
+      grow();
+    }
+    size_t slot = find(source, dest);
+    if (table[slot].source == source && table[slot].dest == dest) {
+      return false;
+    }
+    table[slot].source = source;
+    table[slot].dest = dest;
+    count++;
+    return true;
+  }
+
+  bool contains(Node source, Node dest) const {
+    if (!matrix.empty()) {
+      return matrix[(size_t)source * n + dest];
+    }
+    size_t slot = find(source, dest);
+    return table[slot].source == source && table[slot].dest == dest;
+  }
+
+  //the pairs ordered by source, then dest
+  std::vector<std::pair<Node, Node>> sorted() const {
+    std::vector<std::pair<Node, Node>> pairs;
+    pairs.reserve(count);
+    if (!matrix.empty()) {
+      for (Node i = 0; i < n; ++i) {
+        for (Node j = 0; j < n; ++j) {
+          if (matrix[(size_t)i * n + j]) {
+            pairs.emplace_back(i, j);
+          }
+        }
+      }
+      return pairs;
+    }
+    for (auto& key : table) {
+      if (key.source >= 0) {
+        pairs.emplace_back(key.source, key.dest);
+      }
+    }
+    ParallelSort(pairs);
+    return pairs;
+  }
+
+private:
+  struct Key {
+    Node source;
+    Node dest;
+  };
+
+  Node n;
+  size_t count;
+  size_t mask;
+  std::vector<Key> table;
+  std::vector<bool> matrix;
+
+  static Key empty_key() {
+    Key key;
+    key.source = -1;
+    key.dest = -1;
+    return key;
+  }
+
+  //slot of the pair, or of the empty slot where it would go
+  size_t find(Node source, Node dest) const {
+    unsigned long long h = (unsigned long long)source * 0x9e3779b97f4a7c15ull ^ (unsigned long long)dest;
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 29;
+    size_t slot = (size_t)h & mask;
+    while (table[slot].source >= 0 && (table[slot].source != source || table[slot].dest != dest)) {
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  void grow() {
+    std::vector<Key> old(2 * table.size(), empty_key());
+    old.swap(table);
+    mask = table.size() - 1;
+    for (auto& key : old) {
+      if (key.source >= 0) {
+        table[find(key.source, key.dest)] = key;
+      }
+    }
+  }
+};
@@ -0,0 +1,386 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+#include "Writer.hpp"
+
+//Where external-memory graphs keep their runs and how much memory their arc buffers may take in total,
+//set from the command line before generating.
+struct SpillSettings {
+  std::string directory = ".";
+  size_t memory_bytes = (size_t)1 << 30;
+};
+
+//settings of the command line, every batch job and daemon request starts from them
+inline SpillSettings& SpillDefaults() {
+  static SpillSettings settings;
+  return settings;
+}
+
+//settings of the graph generated on this thread, a job or request may change its own
+inline SpillSettings& Spill() {
+  static thread_local SpillSettings settings = SpillDefaults();
+  return settings;
+}
+
+//Graph that never holds all of its arcs. They are buffered in fixed size runs, a full run is sorted by source
+//and written to the scratch directory, and the output k-way merges the runs. Memory is bounded by
+//Spill().memory_bytes and the size of the graph by the disk. Takes the place of Graph in every generator.
+//The output is the same as the in-memory graph's: by source, the arcs of a source in the order they were added
+//and parallel arcs kept, unless make_simple was called.
+template <typename NodeT, typename CountT, typename WeightT>
+class ExternalGraph {
+public:
+  typedef NodeT Node;
+  typedef CountT Count;
+  typedef WeightT Weight;
+  static const bool kMaterialized = false;
+
+#pragma pack(push, 2)
+  struct Arc {
+    Node source;
+    Node dest;
+    Weight cost;
+
+    bool operator<(const Arc& other) const {
+      if (source != other.source) {
+        return source < other.source;
+      }
+      if (dest != other.dest) {
+        return dest < other.dest;
+      }
+      return cost < other.cost;
+    }
+  };
+#pragma pack(pop)
+
+  Node num_nodes;
+  Count num_edges;
+
+  ExternalGraph(Node a) : num_nodes(a), num_edges(0), state(new State()) {
+    size_t stripes = NumThreads();
+    state->memory_bytes = Spill().memory_bytes;
+    state->stripes.reset(new Stripe[stripes]);
+    state->num_stripes = stripes;
+    //the stable sort of a full buffer takes half a buffer more
+    state->stripe_capacity = std::max(buffer_arcs(stripes) * 2 / 3, (size_t)kMinBufferArcs);
+    std::random_device device;
+    char tag[16];
+    std::snprintf(tag, sizeof(tag), "%08x", device());
+    state->prefix = Spill().directory + "/GraphGen." + tag + ".";
+  }
+  ExternalGraph() {}
+
+  void add_edge(Node source, Node dest, long long cost) {
+    add_arc(source, dest, cost);
+  }
+
+  //Safe to call from several threads. Sources are striped over one buffer per thread, so the threads of a
+  //ParallelFor, which own disjoint ranges of sources, rarely wait for each other.
+  void add_arc(Node source, Node dest, long long cost) {
+    Arc arc;
+    arc.source = source;
+    arc.dest = dest;
+    arc.cost = (Weight)cost;
+    Stripe& stripe = state->stripes[(size_t)(source >> 12) % state->num_stripes];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    if (stripe.arcs.size() == state->stripe_capacity) {
+      spill(stripe.arcs);
+    }
+    if (stripe.arcs.capacity() < state->stripe_capacity) {
+      stripe.arcs.reserve(state->stripe_capacity);
+    }
+    stripe.arcs.push_back(arc);
+  }
+
+  //degrees are only a hint for the in-memory graph
+  void reserve_degrees(const std::vector<Node>&) {}
+
+  //the edges are counted while merging
+  void recount_edges() {}
+
+  //The first scratch file error, empty while every run was written and read. After an error the arcs are
+  //dropped instead of spilled and the output is incomplete, the caller reports it.
+  std::string error() const {
+    std::lock_guard<std::mutex> lock(state->runs_mutex);
+    return state->error;
+  }
+
+  //the arcs of each source are sorted by destination while merging, dropping self-loops and all but the
+  //cheapest of parallel arcs as Graph::make_simple does
+  void make_simple() {
+    state->simple = true;
+  }
+
+  void output_pajek() {
+    WriteHeader(OutputFile(), kPajek, num_nodes, 0, 0);
+    output_edges();
+  }
+  void output_pmed(long long num_centers) {
+    //make_simple drops arcs while merging, so the count takes a merge of its own
+    long long count = 0;
+    merge([&](const Arc&) { count++; });
+    num_edges = (Count)count;
+    WriteHeader(OutputFile(), kPmed, num_nodes, num_edges, num_centers);
+    output_edges();
+  }
+
+  void output_edges() {
+    const size_t kFlushBytes = 1 << 20;
+    EdgeText text;
+    long long count = 0;
+    merge([&](const Arc& arc) {
+      text.add(arc.source, arc.dest, arc.cost);
+      count++;
+      if (text.text.size() >= kFlushBytes) {
+        Stats().bytes += text.text.size();
+        std::fwrite(text.text.data(), 1, text.text.size(), OutputFile());
+        text.text.clear();
+      }
+    });
+    Stats().bytes += text.text.size();
+    std::fwrite(text.text.data(), 1, text.text.size(), OutputFile());
+    std::fflush(OutputFile());
+    num_edges = (Count)count;
+    Stats().edges += count;
+  }
+
+private:
+  static const size_t kMinBufferArcs = 1 << 12;
+  //runs merged at once, more are merged into longer runs first
+  static const size_t kMaxFanIn = 64;
+
+  struct Stripe {
+    std::mutex mutex;
+    std::vector<Arc> arcs;
+  };
+
+  //Reads a run, either a buffer in memory or a file through a buffer of its own.
+  struct Cursor {
+    const Arc* at = nullptr;
+    const Arc* end = nullptr;
+    std::FILE* file = nullptr;
+    std::vector<Arc> buffer;
+
+    bool refill() {
+      if (file == nullptr) {
+        return false;
+      }
+      size_t count = std::fread(buffer.data(), sizeof(Arc), buffer.size(), file);
+      at = buffer.data();
+      end = at + count;
+      if (count == 0) {
+        std::fclose(file);
+        file = nullptr;
+      }
+      return count > 0;
+    }
+
+    bool advance() {
+      return ++at != end || refill();
+    }
+  };
+
+  struct State {
+    std::unique_ptr<Stripe[]> stripes;
+    size_t num_stripes = 0;
+    size_t stripe_capacity = 0;
+    size_t memory_bytes = 0;
+    std::string prefix;
+    long long next_run = 0;
+    std::vector<std::string> runs;
+    std::mutex runs_mutex;
+    bool finished = false;
+    bool simple = false;
+    std::atomic<bool> failed{ false };
+    std::string error;
+
+    ~State() {
+      for (auto& run : runs) {
+        std::remove(run.c_str());
+      }
+    }
+  };
+
+  std::unique_ptr<State> state;
+
+  //arcs in each of `buffers` buffers splitting the memory budget
+  size_t buffer_arcs(size_t buffers) const {
+    size_t arcs = state->memory_bytes / sizeof(Arc) / buffers;
+    return arcs > kMinBufferArcs ? arcs : (size_t)kMinBufferArcs;
+  }
+
+  std::string new_run() {
+    std::lock_guard<std::mutex> lock(state->runs_mutex);
+    state->runs.push_back(state->prefix + std::to_string(state->next_run++) + ".run");
+    return state->runs.back();
+  }
+
+  void fail(const std::string& message) const {
+    std::lock_guard<std::mutex> lock(state->runs_mutex);
+    if (!state->failed) {
+      state->error = message;
+      state->failed = true;
+    }
+  }
+
+  //nullptr once anything failed
+  std::FILE* open_run(const std::string& path, const char* mode) const {
+    if (state->failed) {
+      return nullptr;
+    }
+    std::FILE* file = std::fopen(path.c_str(), mode);
+    if (file == nullptr) {
+      fail("Cannot open run file: " + path);
+    }
+    return file;
+  }
+
+  void write_arcs(std::FILE* file, const std::string& path, const Arc* arcs, size_t count) const {
+    if (!state->failed && std::fwrite(arcs, sizeof(Arc), count, file) != count) {
+      fail("Cannot write run file, is the scratch directory full? " + path);
+    }
+  }
+
+  //sorts the buffer by source, the arcs of a source stay in the order they were added
+  static void sort_run(std::vector<Arc>& arcs) {
+    std::stable_sort(arcs.begin(), arcs.end(), [](const Arc& a, const Arc& b) { return a.source < b.source; });
+  }
+
+  void spill(std::vector<Arc>& arcs) {
+    if (!state->failed) {
+      sort_run(arcs);
+      std::string path = new_run();
+      std::FILE* file = open_run(path, "wb");
+      if (file != nullptr) {
+        write_arcs(file, path, arcs.data(), arcs.size());
+        std::fclose(file);
+      }
+    }
+    arcs.clear();
+  }
+
+  //Calls emit(arc) for every arc of the cursors by source. The arcs of a source come from the earlier cursor
+  //first, and cursors are in the order their runs were written, so they stay in the order they were added.
+  template <typename Emit>
+  static void merge_cursors(std::vector<Cursor>& cursors, Emit emit) {
+    auto later = [&](size_t a, size_t b) {
+      return cursors[b].at->source < cursors[a].at->source || (cursors[b].at->source == cursors[a].at->source && b < a);
+    };
+    std::vector<size_t> heap;
+    for (size_t i = 0; i < cursors.size(); ++i) {
+      if (cursors[i].at != cursors[i].end || cursors[i].refill()) {
+        heap.push_back(i);
+      }
+    }
+    std::make_heap(heap.begin(), heap.end(), later);
+    while (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), later);
+      size_t i = heap.back();
+      Arc arc = *cursors[i].at;
+      if (cursors[i].advance()) {
+        std::push_heap(heap.begin(), heap.end(), later);
+      }
+      else {
+        heap.pop_back();
+      }
+      emit(arc);
+    }
+  }
+
+  //file cursors for the given runs, sharing the memory budget with `extra` more buffers of the same size
+  std::vector<Cursor> open_runs(const std::vector<std::string>& runs, size_t extra) const {
+    std::vector<Cursor> cursors(runs.size());
+    for (size_t i = 0; i < runs.size(); ++i) {
+      cursors[i].file = open_run(runs[i], "rb");
+      cursors[i].buffer.resize(buffer_arcs(runs.size() + extra));
+    }
+    return cursors;
+  }
+
+  //Spills what is still buffered, unless nothing was spilled at all and the buffers can be merged in memory,
+  //and merges runs until few enough are left for one final merge.
+  void finish() {
+    if (state->finished) {
+      return;
+    }
+    state->finished = true;
+    bool in_memory = state->runs.empty();
+    ParallelFor(0, state->num_stripes, 1, [&](long long begin, long long, long long) {
+      std::vector<Arc>& arcs = state->stripes[begin].arcs;
+      if (in_memory) {
+        sort_run(arcs);
+      }
+      else {
+        if (!arcs.empty()) {
+          spill(arcs);
+        }
+        std::vector<Arc>().swap(arcs);
+      }
+    });
+    while (state->runs.size() > kMaxFanIn && !state->failed) {
+      std::vector<std::string> group(state->runs.begin(), state->runs.begin() + kMaxFanIn);
+      state->runs.erase(state->runs.begin(), state->runs.begin() + kMaxFanIn);
+      std::vector<Cursor> cursors = open_runs(group, 1);
+      std::string path = new_run();
+      std::FILE* file = open_run(path, "wb");
+      if (file == nullptr) {
+        //left to the destructor to remove
+        state->runs.insert(state->runs.end(), group.begin(), group.end());
+        break;
+      }
+      std::vector<Arc> out;
+      out.reserve(cursors[0].buffer.size());
+      merge_cursors(cursors, [&](const Arc& arc) {
+        out.push_back(arc);
+        if (out.size() == out.capacity()) {
+          write_arcs(file, path, out.data(), out.size());
+          out.clear();
+        }
+      });
+      write_arcs(file, path, out.data(), out.size());
+      std::fclose(file);
+      for (auto& run : group) {
+        std::remove(run.c_str());
+      }
+      //the merged run takes the place of its group, ahead of the later runs
+      state->runs.pop_back();
+      state->runs.insert(state->runs.begin(), path);
+    }
+  }
+
+  template <typename Emit>
+  void merge(Emit emit) {
+    finish();
+    std::vector<Cursor> cursors = open_runs(state->runs, 0);
+    for (size_t i = 0; i < state->num_stripes; ++i) {
+      std::vector<Arc>& arcs = state->stripes[i].arcs;
+      if (!arcs.empty()) {
+        Cursor cursor;
+        cursor.at = arcs.data();
+        cursor.end = arcs.data() + arcs.size();
+        cursors.push_back(std::move(cursor));
+      }
+    }
+    if (!state->simple) {
+      merge_cursors(cursors, emit);
+      return;
+    }
+    std::vector<Arc> arcs;
+    auto emit_simple = [&]() {
+      std::sort(arcs.begin(), arcs.end());
+      for (size_t i = 0; i < arcs.size(); ++i) {
+        if (arcs[i].source != arcs[i].dest && (i == 0 || arcs[i].dest != arcs[i - 1].dest)) {
+          emit(arcs[i]);
+        }
+      }
+      arcs.clear();
+    };
+    merge_cursors(cursors, [&](const Arc& arc) {
+      if (!arcs.empty() && arcs[0].source != arc.source) {
+        emit_simple();
+      }
+      arcs.push_back(arc);
+    });
+    emit_simple();
+  }
+};
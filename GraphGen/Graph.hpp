@@ -1,169 +1,625 @@
 #include "stdafx.h"
+#include "Parallel.hpp"
+#include "Arena.hpp"
+#include "EdgeSet.hpp"
+#include "Writer.hpp"
+#include "ExternalGraph.hpp"
+#include "Delaunay.hpp"
+#include "EdgeRange.hpp"
 
+const double kPi = 3.14159265358979323846;
+const int kMaxLatticeDims = 16;
+//blocks of the generators that also have a lazy EdgeRange, both cut the same blocks to draw the same edges
+const long long kRandomRowGrain = 1 << 12;
+const long long kChungLuVertexGrain = 1 << 12;
+const long long kBlockModelRowGrain = 1 << 12;
+const long long kBipartiteRowGrain = 1 << 12;
+const long long kLatticeSlabGrain = 1 << 16;
+
+//Number of failed Bernoulli trials before the next success, log_q is log(1 - p).
+inline long long GeometricSkip(std::default_random_engine& random_engine, double log_q) {
+  std::uniform_real_distribution<double> r_double(0, 1);
+  double skip = std::floor(std::log(1 - r_double(random_engine)) / log_q);
+  return skip < 1e18 ? (long long)skip : (long long)1e18;
+}
+
+//Adjacency lists of a graph, generic over the node id, edge count and cost types, so small graphs can use
+//compact 32 bit ids and 16 bit costs and large ones 64 bit ids.
+template <typename NodeT, typename CountT, typename WeightT>
 class Graph {
 public:
-  int num_nodes;
-  int num_edges;
-  std::vector<std::vector<std::pair<int, int>>> adj_list;
+  typedef NodeT Node;
+  typedef CountT Count;
+  typedef WeightT Weight;
+  static const bool kMaterialized = true;
+
+  //packed, 32 bit ids with 16 bit costs take 6 bytes per arc instead of 8
+#pragma pack(push, 2)
+  struct Arc {
+    Node dest;
+    Weight cost;
+  };
+#pragma pack(pop)
+
+  Node num_nodes;
+  Count num_edges;
+  LargeArray<ArenaList<Arc, Node>> adj_list;
+  std::unique_ptr<Arena<Arc>> arena;
 
-  Graph(int a) : adj_list(a, std::vector<std::pair<int, int>>()), num_nodes(a), num_edges(0) {}
+  Graph(Node a) : num_nodes(a), num_edges(0), adj_list(a), arena(new Arena<Arc>()) {}
   Graph() {}
 
-  void add_edge(int source, int dest, int cost) {
-    adj_list[source].emplace_back(std::make_pair(dest, cost));
+  //costs are drawn as int or long long and narrowed here, the caller keeps them in range of Weight
+  void add_edge(Node source, Node dest, long long cost) {
+    add_arc(source, dest, cost);
     num_edges++;
   }
 
+  //Does not touch num_edges, so threads that own disjoint sources can fill the graph
+  //concurrently; call recount_edges() once they are done.
+  void add_arc(Node source, Node dest, long long cost) {
+    Arc arc;
+    arc.dest = dest;
+    arc.cost = (Weight)cost;
+    adj_list[source].push_back(*arena, arc);
+  }
+
+  //Sizes every empty list for its final degree, all of them in one run of the arena.
+  void reserve_degrees(const std::vector<Node>& degrees) {
+    size_t total = 0;
+    for (Node degree : degrees) {
+      total += degree;
+    }
+    if (total == 0) {
+      return;
+    }
+    Arc* run = arena->allocate(total);
+    for (size_t i = 0; i < degrees.size(); ++i) {
+      adj_list[i].assign_run(run, degrees[i]);
+      run += degrees[i];
+    }
+  }
+
+  void recount_edges() {
+    num_edges = 0;
+    for (auto& neighbours : adj_list) {
+      num_edges += (Count)neighbours.size();
+    }
+  }
+
+  //an in-memory graph has no scratch files to fail, see ExternalGraph
+  std::string error() const {
+    return std::string();
+  }
+
+  //Sorts every list by destination and drops self-loops and parallel arcs, keeping the cheapest of them.
+  void make_simple() {
+    const long long kVertexGrain = 1 << 14;
+    ParallelFor(0, num_nodes, kVertexGrain, [&](long long begin, long long end, long long) {
+      for (long long i = begin; i < end; ++i) {
+        auto& neighbours = adj_list[i];
+        std::sort(neighbours.begin(), neighbours.end(), [](const Arc& a, const Arc& b) {
+          return a.dest != b.dest ? a.dest < b.dest : a.cost < b.cost;
+        });
+        size_t kept = 0;
+        for (size_t j = 0; j < neighbours.size(); ++j) {
+          if (neighbours[j].dest != i && (kept == 0 || neighbours[kept - 1].dest != neighbours[j].dest)) {
+            neighbours[kept++] = neighbours[j];
+          }
+        }
+        neighbours.truncate(kept);
+      }
+    });
+    recount_edges();
+  }
+
   void output_pajek() {
-    std::cout << "*vertices " << num_nodes << std::endl;
-    std::cout << "*arcs" << std::endl;
-    for (int i = 0; i < num_nodes; ++i) {
-      auto neighbours = adj_list[i];
-      for (auto j : neighbours) {
-        std::cout << i + 1 << ' ' << j.first + 1 << ' ' << j.second << std::endl;
+    WriteHeader(OutputFile(), kPajek, num_nodes, num_edges, 0);
+    output_edges();
+  }
+  void output_pmed(long long num_centers) {
+    WriteHeader(OutputFile(), kPmed, num_nodes, num_edges, num_centers);
+    output_edges();
+  }
+
+  void output_edges() {
+    const long long kVertexGrain = 1 << 14;
+    WriteEdgeBlocks(OutputFile(), num_nodes, kVertexGrain, [&](long long begin, long long end, long long, EdgeText& text) {
+      for (long long i = begin; i < end; ++i) {
+        for (auto& j : adj_list[i]) {
+          text.add(i, j.dest, j.cost);
+        }
       }
-    }
+    });
+  }
+};
+
+
+//Rows to move down when a skip runs excess columns past the end of a row of a triangle, where the next
+//rows hold width - 1, width - 2, ... columns. 0 when the skip runs past the last row with a column.
+inline long long TriangleRows(long long width, long long excess) {
+  auto columns = [&](long long k) { return k * width - k * (k + 1) / 2; };
+  if (width <= 1 || columns(width - 1) <= excess) {
+    return 0;
+  }
+  //smallest k with columns(k) > excess, from the quadratic and then corrected for rounding
+  double b = 2.0 * width - 1;
+  long long k = (long long)((b - std::sqrt(std::max(0.0, b * b - 8.0 * excess))) / 2) + 1;
+  k = std::min(std::max(k, 1LL), width - 1);
+  while (columns(k) <= excess) {
+    k++;
+  }
+  while (k > 1 && columns(k - 1) > excess) {
+    k--;
   }
-  void output_pmed(int num_centers) {
-    std::cout << num_nodes << ' ' << num_edges << ' ' << num_centers << std::endl;
-    for (int i = 0; i < num_nodes; ++i) {
-      auto neighbours = adj_list[i];
-      for (auto j : neighbours) {
-        std::cout << i + 1 << ' ' << j.first + 1 << ' ' << j.second << std::endl;
+  return k;
+}
+
+//Draws the pairs (i, j) with begin <= i < end and first(i) <= j < col_end one at a time, each with
+//probability p. first(i) is col_begin, or i + 1 for the upper triangle. Rejected pairs are skipped
+//geometrically and a skip past the end of a row lands in the row it reaches, found without stepping
+//through the rows in between, so the cost is O(drawn pairs + 1) (Batagelj & Brandes).
+class PairSampler {
+public:
+  PairSampler() {}
+  PairSampler(long long begin, long long end, long long col_begin, long long col_end, bool triangle, double p)
+    : i(p <= 0 ? end : begin), j((triangle ? begin + 1 : col_begin) - 1), end(end), col_begin(col_begin), col_end(col_end), triangle(triangle), log_q(std::log(1 - p)) {}
+
+  //the next pair, false once the rows are done
+  bool next(std::default_random_engine& random_engine, long long& row, long long& col) {
+    if (i >= end) {
+      return false;
+    }
+    j += 1 + GeometricSkip(random_engine, log_q);
+    if (j >= col_end) {
+      long long excess = j - col_end;
+      if (triangle) {
+        long long width = col_end - i - 1;
+        long long rows = TriangleRows(width, excess);
+        i = rows == 0 ? end : i + rows;
+        j = col_end + excess - (rows * width - rows * (rows + 1) / 2);
+      }
+      else {
+        long long width = col_end - col_begin;
+        i = width <= 0 ? end : i + excess / width + 1;
+        j = col_begin + (width <= 0 ? 0 : excess % width);
       }
     }
+    row = i;
+    col = j;
+    return i < end;
   }
+
+private:
+  long long i = 0;
+  long long j = 0;
+  long long end = 0;
+  long long col_begin = 0;
+  long long col_end = 0;
+  bool triangle = false;
+  double log_q = 0;
 };
 
+//Calls emit(i, j) for every pair a PairSampler draws.
+template <typename Emit>
+void SkipSamplePairs(long long begin, long long end, long long col_begin, long long col_end, bool triangle, double p, std::default_random_engine& random_engine, Emit emit) {
+  PairSampler sampler(begin, end, col_begin, col_end, triangle, p);
+  long long i;
+  long long j;
+  while (sampler.next(random_engine, i, j)) {
+    emit(i, j);
+  }
+}
+
+//Arcs one thread emitted during a BuildGraph in the order they came, the sources as runs of consecutive arcs.
+//The arcs go to fixed chunks, so the buffer never moves or overshoots and is freed a chunk at a time. Freed
+//chunks are kept as spares of the thread up to a few, for the next build on that thread.
+template <typename Node, typename Arc>
+struct EmittedArcs {
+  static const size_t kChunkArcs = 1 << 16;
+  static const size_t kMaxSpareChunks = 16;
 
-Graph RandomGraph(int n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
-  Graph G(n);
-  std::uniform_int_distribution<int> r_int(cmin, cmax);
-  std::uniform_real_distribution<double> r_double(0, 1);
+  std::vector<std::unique_ptr<Arc[]>> chunks;
+  size_t last_used = kChunkArcs;
+  std::vector<std::pair<Node, size_t>> runs;
 
-  for (int i = 0; i < n; ++i) {
-    int j;
-    if (directed) {
-      j = 0;
+  void push_back(Node source, const Arc& arc) {
+    if (runs.empty() || runs.back().first != source) {
+      runs.emplace_back(source, 0);
     }
-    else {
-      j = i + 1;
+    runs.back().second++;
+    if (last_used == kChunkArcs) {
+      auto& spare = SpareChunks();
+      if (spare.empty()) {
+        chunks.emplace_back(new Arc[kChunkArcs]);
+      }
+      else {
+        chunks.push_back(std::move(spare.back()));
+        spare.pop_back();
+      }
+      last_used = 0;
     }
-    for (; j < n; ++j) {
-      if (r_double(random_engine) < density) {
-        G.add_edge(i, j, r_int(random_engine));
+    chunks.back()[last_used++] = arc;
+  }
+
+  //add(source, arc) for every arc in the order they came, freeing the chunks on the way
+  template <typename Add>
+  void drain(Add add) {
+    size_t chunk = 0;
+    size_t used = 0;
+    for (auto& run : runs) {
+      for (size_t k = 0; k < run.second; ++k) {
+        if (used == kChunkArcs) {
+          release(chunks[chunk++]);
+          used = 0;
+        }
+        add(run.first, chunks[chunk][used++]);
       }
     }
+    for (; chunk < chunks.size(); ++chunk) {
+      release(chunks[chunk]);
+    }
+    chunks.clear();
+    std::vector<std::pair<Node, size_t>>().swap(runs);
+  }
+
+  static std::vector<std::unique_ptr<Arc[]>>& SpareChunks() {
+    static thread_local std::vector<std::unique_ptr<Arc[]>> spare;
+    return spare;
+  }
+
+  static void release(std::unique_ptr<Arc[]>& chunk) {
+    auto& spare = SpareChunks();
+    if (spare.size() < kMaxSpareChunks) {
+      spare.push_back(std::move(chunk));
+    }
+    chunk.reset();
   }
+};
+
+//The buffer of the build running on this thread, cached by build number so emitting an arc takes no lock.
+//Build numbers are never reused, so a stale entry left by an earlier build is never taken for a later one.
+inline std::pair<unsigned long long, void*>& EmittedArcsCache() {
+  static thread_local std::pair<unsigned long long, void*> cache(0, nullptr);
+  return cache;
+}
+
+inline unsigned long long NextBuildNumber() {
+  static std::atomic<unsigned long long> next(1);
+  return next++;
+}
+
+template <typename GraphT, typename Fill>
+GraphT BuildGraphWith(typename GraphT::Node n, Fill fill, std::false_type) {
+  typedef typename GraphT::Node Node;
+  GraphT G(n);
+  fill([&](Node source, Node dest, long long cost) { G.add_arc(source, dest, cost); });
   return G;
 }
 
-Graph SimpleConnectedRandomGraph(int n, std::default_random_engine random_engine, double density, int cmin, int cmax) {
-  std::vector<bool> AdjMatrix(n*n);
-  int num_edges = 0;
-  std::uniform_int_distribution<int> r_weight(cmin, cmax);
-  std::set<int> T;
-  std::set<int> S;
-  std::uniform_int_distribution<int> r_node(0, n - 1);
-  int current_node = r_node(random_engine);
-  T.emplace(current_node);
-  for (int i = 0; i < n; ++i) {
-    if (i != current_node) {
-      S.emplace(i);
+template <typename GraphT, typename Fill>
+GraphT BuildGraphWith(typename GraphT::Node n, Fill fill, std::true_type) {
+  typedef typename GraphT::Node Node;
+  typedef typename GraphT::Arc Arc;
+  typedef EmittedArcs<Node, Arc> Buffer;
+  unsigned long long build = NextBuildNumber();
+  std::mutex mutex;
+  std::map<std::thread::id, std::unique_ptr<Buffer>> buffers;
+  fill([&](Node source, Node dest, long long cost) {
+    auto& cache = EmittedArcsCache();
+    if (cache.first != build) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto& buffer = buffers[std::this_thread::get_id()];
+      if (!buffer) {
+        buffer.reset(new Buffer());
+      }
+      cache = std::make_pair(build, (void*)buffer.get());
+    }
+    Arc arc;
+    arc.dest = dest;
+    arc.cost = (typename GraphT::Weight)cost;
+    ((Buffer*)cache.second)->push_back(source, arc);
+  });
+
+  std::vector<Buffer*> emitted;
+  std::vector<Node> degrees(n, 0);
+  for (auto& buffer : buffers) {
+    emitted.push_back(buffer.second.get());
+    for (auto& run : buffer.second->runs) {
+      degrees[run.first] += (Node)run.second;
     }
   }
+  GraphT G(n);
+  G.reserve_degrees(degrees);
+  std::vector<Node>().swap(degrees);
+  //every source is owned by one block, and so by one buffer
+  ParallelFor(0, emitted.size(), 1, [&](long long begin, long long end, long long) {
+    for (long long b = begin; b < end; ++b) {
+      emitted[b]->drain([&](Node source, const Arc& arc) { G.add_arc(source, arc.dest, arc.cost); });
+    }
+  });
+  G.recount_edges();
+  return G;
+}
 
-  while (!S.empty()) {
-    int neighbour_node = r_node(random_engine);
-    if (T.find(neighbour_node) == T.end()) {
-      AdjMatrix[n*current_node + neighbour_node] = true;
-      AdjMatrix[n*neighbour_node + current_node] = true;
-      num_edges++;
-      S.erase(neighbour_node);
-      T.emplace(neighbour_node);
+//Builds a graph from fill(emit), which calls emit(source, dest, cost) for every arc and may emit concurrently
+//only for sources it owns, in a single pass. The arcs are buffered per thread as they come, then every list
+//is sized for its final degree and the arcs are scattered into them. A graph that is not materialized takes
+//the arcs as they come.
+template <typename GraphT, typename Fill>
+GraphT BuildGraph(typename GraphT::Node n, Fill fill) {
+  return BuildGraphWith<GraphT>(n, fill, std::integral_constant<bool, GraphT::kMaterialized>());
+}
+
+//BuildGraph for a generator that knows the degree of every source, or a bound on it, before it runs. The
+//lists are sized up front and fill writes straight into them.
+template <typename GraphT, typename Fill>
+GraphT BuildGraph(typename GraphT::Node n, const std::vector<typename GraphT::Node>& degrees, Fill fill) {
+  typedef typename GraphT::Node Node;
+  GraphT G(n);
+  G.reserve_degrees(degrees);
+  fill([&](Node source, Node dest, long long cost) { G.add_arc(source, dest, cost); });
+  G.recount_edges();
+  return G;
+}
+
+//Emits the edges of the rows [begin, end) of a random graph, block `block` of kRandomRowGrain rows.
+template <typename Emit>
+void RandomEdges(long long n, bool directed, double density, unsigned seed, int cmin, int cmax, long long begin, long long end, long long block, Emit emit) {
+  auto engine = BlockEngine(seed, block);
+  std::uniform_int_distribution<int> r_int(cmin, cmax);
+  SkipSamplePairs(begin, end, 0, n, !directed, density, engine, [&](long long i, long long j) {
+    emit(i, j, r_int(engine));
+  });
+}
+
+template <typename GraphT>
+GraphT RandomGraph(typename GraphT::Node n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  unsigned seed = random_engine();
+  return BuildGraph<GraphT>(n, [&](auto emit) {
+    ParallelForSlice(n, kRandomRowGrain, [&](long long begin, long long end, long long block) {
+      RandomEdges(n, directed, density, seed, cmin, cmax, begin, end, block, [&](long long i, long long j, long long cost) {
+        emit((Node)i, (Node)j, cost);
+      });
+    });
+  });
+}
+
+//Random graph written straight to out in parallel blocks of rows, the same edges RandomGraph stores.
+void StreamRandomGraph(std::FILE* out, OutputFormat format, long long num_centers, long long n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  StreamGraph(out, format, n, num_centers, kRandomRowGrain, [&](long long begin, long long end, long long block, auto emit) {
+    RandomEdges(n, directed, density, seed, cmin, cmax, begin, end, block, emit);
+  });
+}
+
+//Cursor of an EdgeRange over rows [0, rows) skip sampled against the columns [col_begin, col_end) in blocks of
+//`grain` rows, each with its own engine, like RandomEdges and the rows of BipartiteGraph.
+class SkipSampleCursor {
+public:
+  SkipSampleCursor() {}
+  SkipSampleCursor(unsigned seed, long long rows, long long col_begin, long long col_end, bool triangle, double p, long long grain, int cmin, int cmax)
+    : seed(seed), rows(rows), col_begin(col_begin), col_end(col_end), triangle(triangle), p(p), grain(grain), r_int(cmin, cmax) {}
+
+  template <typename Node>
+  bool next(Edge<Node>& edge) {
+    long long i;
+    long long j;
+    while (!sampler.next(engine, i, j)) {
+      long long begin = (block + 1) * grain;
+      if (begin >= rows) {
+        return false;
+      }
+      block++;
+      engine = BlockEngine(seed, block);
+      r_int.reset();
+      sampler = PairSampler(begin, std::min(begin + grain, rows), col_begin, col_end, triangle, p);
     }
-    current_node = neighbour_node;
+    edge.source = (Node)i;
+    edge.dest = (Node)j;
+    edge.cost = r_int(engine);
+    return true;
   }
-  int wanted_edges = int(density * n * (n - 1) / 2);
-  while (num_edges < wanted_edges) {
-    int a = r_node(random_engine);
-    int b = r_node(random_engine);
-    if (a!=b && !AdjMatrix[n*a + b]) {
-      AdjMatrix[n*a + b] = true;
-      AdjMatrix[n*b + a] = true;
-      num_edges++;
+
+private:
+  unsigned seed = 0;
+  long long rows = 0;
+  long long col_begin = 0;
+  long long col_end = 0;
+  bool triangle = false;
+  double p = 0;
+  long long grain = 1;
+  std::uniform_int_distribution<int> r_int;
+  long long block = -1;
+  std::default_random_engine engine;
+  PairSampler sampler;
+};
+
+//The edges RandomGraph draws from the same engine, generated lazily.
+template <typename Node>
+EdgeRange<Node, SkipSampleCursor> RandomEdgeRange(Node n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  return MakeEdgeRange<Node>(SkipSampleCursor(seed, n, 0, n, !directed, density, kRandomRowGrain, cmin, cmax));
+}
+
+template <typename GraphT>
+GraphT SimpleConnectedRandomGraph(typename GraphT::Node n, std::default_random_engine random_engine, double density, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  long long wanted_edges = (long long)(density * n * (n - 1) / 2);
+  //edges as (smaller, larger)
+  EdgeSet<Node> edges(n, (size_t)std::max<long long>(wanted_edges, n - 1));
+  std::uniform_int_distribution<int> r_weight(cmin, cmax);
+  std::vector<bool> in_tree(n, false);
+  Node outside = n - 1;
+  std::uniform_int_distribution<Node> r_node(0, n - 1);
+  Node current_node = r_node(random_engine);
+  in_tree[current_node] = true;
+  //for --stats, steps onto a node already in the tree and pairs already drawn are rejected
+  long long draws = 1;
+  long long rejected = 0;
+
+  //random walk spanning tree
+  while (outside > 0) {
+    Node neighbour_node = r_node(random_engine);
+    draws++;
+    if (!in_tree[neighbour_node]) {
+      edges.insert(std::min(current_node, neighbour_node), std::max(current_node, neighbour_node));
+      in_tree[neighbour_node] = true;
+      outside--;
     }
+    else {
+      rejected++;
+    }
+    current_node = neighbour_node;
   }
-  Graph G(n);
-  for (int i = 0; i < n; ++i) {
-    for (int j = i + 1; j < n; ++j) {
-      if (AdjMatrix[n*i + j]) {
-        G.add_edge(i, j, r_weight(random_engine));
-      }
+  while ((long long)edges.size() < wanted_edges) {
+    Node a = r_node(random_engine);
+    Node b = r_node(random_engine);
+    draws += 2;
+    if (a == b || !edges.insert(std::min(a, b), std::max(a, b))) {
+      rejected++;
     }
   }
+  GraphT G(n);
+  for (auto& edge : edges.sorted()) {
+    G.add_edge(edge.first, edge.second, r_weight(random_engine));
+  }
+  Stats().add_samples(draws + (long long)edges.size(), rejected);
   return G;
 }
 
-Graph Random2DGridGraph(int n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
-  std::uniform_int_distribution<int> r_int(cmin, cmax);
-  std::uniform_real_distribution<double> r_double(0, 1);
-  int old_n = n;
-  n = int(std::sqrt(n));
-  int n2 = n * n;
+template <typename GraphT>
+GraphT Random2DGridGraph(typename GraphT::Node n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  Node old_n = n;
+  n = Node(std::sqrt((double)n));
+  Node n2 = n * n;
   if (n2 != old_n) {
     std::cerr << "num nodes was not a perfect square, new n is " << n2 << std::endl;;
   }
-  Graph g(n2);
-  for (int i = 0; i < n2; ++i) {
+  //every node links at most to the neighbours it has, the lists are sized for all of them
+  std::vector<Node> bounds(n2);
+  for (Node i = 0; i < n2; ++i) {
+    bounds[i] = (Node)((i + n < n2) + (i % n != 0) + (directed ? (i - n >= 0) + ((i + 1) % n != 0) : 0));
+  }
+  return BuildGraph<GraphT>(n2, bounds, [&](auto emit) {
+    auto engine = random_engine;
+    std::uniform_int_distribution<int> r_int(cmin, cmax);
+    std::uniform_real_distribution<double> r_double(0, 1);
+    for (Node i = 0; i < n2; ++i) {
 
-    int d = i + n; //down
-    int l = i - 1; //left
-    int u = i - n; //up
-    int r = i + 1; //right
+      Node d = i + n; //down
+      Node l = i - 1; //left
+      Node u = i - n; //up
+      Node r = i + 1; //right
 
-    //down
-    if (d < n2) {
-      if (r_double(random_engine) < density) {
-        g.add_edge(i, d, r_int(random_engine));
+      //down
+      if (d < n2) {
+        if (r_double(engine) < density) {
+          emit(i, d, r_int(engine));
+        }
       }
-    }
-    //left
-    if (i%n != 0) {
-      if (r_double(random_engine) < density) {
-        g.add_edge(i, l, r_int(random_engine));
+      //left
+      if (i%n != 0) {
+        if (r_double(engine) < density) {
+          emit(i, l, r_int(engine));
 
-      }
-    }
-    if (directed) {
-      //up
-      if (u >= 0) {
-        if (r_double(random_engine) < density) {
-          g.add_edge(i, u, r_int(random_engine));
         }
       }
-      //right
-      if (r%n != 0) {
-        if (r_double(random_engine) < density) {
-          g.add_edge(i, r, r_int(random_engine));
+      if (directed) {
+        //up
+        if (u >= 0) {
+          if (r_double(engine) < density) {
+            emit(i, u, r_int(engine));
+          }
+        }
+        //right
+        if (r%n != 0) {
+          if (r_double(engine) < density) {
+            emit(i, r, r_int(engine));
+          }
         }
       }
+
     }
+  });
+}
 
+//Cursor of an EdgeRange over the links Random2DGridGraph draws, node after node from one engine.
+class GridCursor {
+public:
+  GridCursor() {}
+  GridCursor(std::default_random_engine engine, long long side, bool directed, double density, int cmin, int cmax)
+    : engine(engine), side(side), directed(directed), density(density), r_int(cmin, cmax) {}
+
+  template <typename Node>
+  bool next(Edge<Node>& edge) {
+    long long n2 = side * side;
+    while (i < n2) {
+      long long source = i;
+      long long dest = -1;
+      //down, left, and for directed grids up and right
+      switch (link) {
+      case 0:
+        dest = i + side < n2 ? i + side : -1;
+        break;
+      case 1:
+        dest = i % side != 0 ? i - 1 : -1;
+        break;
+      case 2:
+        dest = directed && i - side >= 0 ? i - side : -1;
+        break;
+      case 3:
+        dest = directed && (i + 1) % side != 0 ? i + 1 : -1;
+        break;
+      }
+      if (++link == 4) {
+        link = 0;
+        i++;
+      }
+      if (dest >= 0 && r_double(engine) < density) {
+        edge.source = (Node)source;
+        edge.dest = (Node)dest;
+        edge.cost = r_int(engine);
+        return true;
+      }
+    }
+    return false;
   }
-  return g;
+
+private:
+  std::default_random_engine engine;
+  long long side = 1;
+  bool directed = false;
+  double density = 0;
+  std::uniform_int_distribution<int> r_int;
+  std::uniform_real_distribution<double> r_double{ 0, 1 };
+  long long i = 0;
+  int link = 0;
+};
+
+//The edges Random2DGridGraph draws from the same engine, generated lazily.
+template <typename Node>
+EdgeRange<Node, GridCursor> GridEdgeRange(Node n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
+  return MakeEdgeRange<Node>(GridCursor(random_engine, (long long)std::sqrt((double)n), directed, density, cmin, cmax));
 }
 
-Graph RandomScaleFreeGraph(int n, std::default_random_engine random_engine, int initial_nodes, double offset_exponent, int min_degree, int cmin, int cmax) {
+
+template <typename GraphT>
+GraphT RandomScaleFreeGraph(typename GraphT::Node n, std::default_random_engine random_engine, int initial_nodes, double offset_exponent, int min_degree, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
   std::uniform_int_distribution<int> r_int(cmin, cmax);
   std::uniform_real_distribution<double> r_double(0, 1);
-  std::vector<int> neighbour_counts(n, 0);
-  int total_edges;
-  Graph G(n);
+  std::vector<Node> neighbour_counts(n, 0);
+  //the node a candidate was last linked to, so no node links to the same candidate twice
+  std::vector<Node> linked(n, -1);
+  long long total_edges = 0;
+  GraphT G(n);
 
   //full graph from inital nodes
-  for (int i = 0; i < initial_nodes; ++i) {
-    for (int j = i + 1; j < initial_nodes; ++j) {
+  for (Node i = 0; i < initial_nodes; ++i) {
+    for (Node j = i + 1; j < initial_nodes; ++j) {
       G.add_edge(i, j, r_int(random_engine));
       neighbour_counts[i]++;
       neighbour_counts[j]++;
@@ -171,21 +627,1235 @@ Graph RandomScaleFreeGraph(int n, std::default_random_engine random_engine, int
     }
   }
 
+  //for --stats, candidates already linked or turned down by their degree are rejected
+  long long draws = initial_nodes * (initial_nodes - 1LL) / 2;
+  long long rejected = 0;
+
   //preferential growth
-  for (int i = initial_nodes; i < n; ++i) {
+  for (Node i = initial_nodes; i < n; ++i) {
     while (neighbour_counts[i] < min_degree) {
-      std::uniform_int_distribution<int> r_candidate(0, i - 1);
-      int candidate_node = r_candidate(random_engine);
-      double p = (double)neighbour_counts[candidate_node] / (double)total_edges;
+      std::uniform_int_distribution<Node> r_candidate(0, i - 1);
+      Node candidate_node = r_candidate(random_engine);
+      draws++;
+      if (linked[candidate_node] == i) {
+        rejected++;
+        continue;
+      }
+      //a single initial node has no edges to prefer by
+      double p = total_edges == 0 ? 1.0 : (double)neighbour_counts[candidate_node] / (double)total_edges;
       p = std::pow(p, offset_exponent);
+      draws++;
       if (r_double(random_engine) < p) {
         G.add_edge(i, candidate_node, r_int(random_engine));
+        draws++;
+        linked[candidate_node] = i;
         neighbour_counts[i]++;
         neighbour_counts[candidate_node]++;
         total_edges += 2;
       }
+      else {
+        rejected++;
+      }
+    }
+  }
+  Stats().add_samples(draws, rejected);
+
+  return G;
+}
+
+//Preferential attachment with triad formation (Holme & Kim). Every new node makes `edges` links, the first by
+//preferential attachment; after that each link closes a triangle with probability triad_p by joining a random
+//neighbour of the last preferential target, and falls back to preferential attachment otherwise. Preferential
+//targets are uniform picks from a flat array holding both ends of every edge, so a step costs O(1).
+template <typename GraphT>
+GraphT HolmeKimGraph(typename GraphT::Node n, std::default_random_engine random_engine, int initial_nodes, int edges, double triad_p, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  std::uniform_int_distribution<int> r_int(cmin, cmax);
+  std::uniform_real_distribution<double> r_double(0, 1);
+  std::vector<Node> endpoints;
+  endpoints.reserve(2 * ((size_t)initial_nodes * initial_nodes / 2 + (size_t)(n - initial_nodes) * edges));
+  std::vector<std::vector<Node>> neighbours(n);
+  std::vector<Node> linked(n, -1);
+  std::vector<Node> targets;
+  GraphT G(n);
+
+  auto link = [&](Node i, Node j) {
+    G.add_edge(i, j, r_int(random_engine));
+    neighbours[i].push_back(j);
+    neighbours[j].push_back(i);
+    linked[j] = i;
+  };
+
+  //full graph from inital nodes
+  for (Node i = 0; i < initial_nodes; ++i) {
+    for (Node j = i + 1; j < initial_nodes; ++j) {
+      link(i, j);
+      endpoints.push_back(i);
+      endpoints.push_back(j);
+    }
+  }
+
+  for (Node i = initial_nodes; i < n; ++i) {
+    std::uniform_int_distribution<Node> r_uniform(0, i - 1);
+    std::uniform_int_distribution<size_t> r_endpoint(0, endpoints.empty() ? 0 : endpoints.size() - 1);
+    auto preferential = [&]() {
+      Node candidate;
+      do {
+        candidate = endpoints.empty() ? r_uniform(random_engine) : endpoints[r_endpoint(random_engine)];
+      } while (linked[candidate] == i);
+      return candidate;
+    };
+    linked[i] = i;
+    targets.clear();
+    Node last = -1;
+    for (int e = 0; e < edges; ++e) {
+      Node target = -1;
+      if (last >= 0 && r_double(random_engine) < triad_p) {
+        std::uniform_int_distribution<size_t> r_neighbour(0, neighbours[last].size() - 1);
+        Node candidate = neighbours[last][r_neighbour(random_engine)];
+        if (linked[candidate] != i) {
+          target = candidate;
+        }
+      }
+      if (target < 0) {
+        target = preferential();
+        last = target;
+      }
+      link(i, target);
+      targets.push_back(target);
+    }
+    //new endpoints only count from the next node on
+    for (Node target : targets) {
+      endpoints.push_back(i);
+      endpoints.push_back(target);
     }
   }
 
   return G;
-}
\ No newline at end of file
+}
+
+//Maps a distance in [0, max_dist] linearly onto the cost range [cmin, cmax].
+inline int EuclideanCost(double dist, double max_dist, int cmin, int cmax) {
+  return cmin + (int)std::lround((cmax - cmin) * std::min(1.0, dist / max_dist));
+}
+
+//Points are uniform in the unit square (dim 2) or cube (dim 3) and are joined when closer than radius.
+//Points are binned into a grid of cells at least radius wide, so only neighbouring cells are compared.
+template <typename GraphT>
+GraphT RandomGeometricGraph(typename GraphT::Node n, std::default_random_engine random_engine, bool directed, int dim, double radius, bool euclidean_cost, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  const long long kPointGrain = 1 << 16;
+  const long long kCellGrain = 1 << 10;
+  unsigned point_seed = random_engine();
+  unsigned edge_seed = random_engine();
+
+  std::vector<float> points((size_t)n * dim);
+  ParallelFor(0, n, kPointGrain, [&](long long begin, long long end, long long block) {
+    auto engine = BlockEngine(point_seed, block);
+    std::uniform_real_distribution<float> r_coord(0, 1);
+    for (long long i = begin * dim; i < end * dim; ++i) {
+      points[i] = r_coord(engine);
+    }
+  });
+
+  //cell grid, never more cells than points
+  int cells = (int)std::max(1.0, std::min(std::floor(1 / radius), std::ceil(std::pow(n, 1.0 / dim))));
+  long long num_cells = 1;
+  for (int d = 0; d < dim; ++d) {
+    num_cells *= cells;
+  }
+
+  //counting sort of the points by cell
+  std::vector<Node> cell_of(n);
+  std::unique_ptr<std::atomic<Node>[]> cell_count(new std::atomic<Node>[num_cells]());
+  ParallelFor(0, n, kPointGrain, [&](long long begin, long long end, long long) {
+    for (long long i = begin; i < end; ++i) {
+      Node c = 0;
+      for (int d = 0; d < dim; ++d) {
+        c = c * cells + std::min(cells - 1, (int)(points[i * dim + d] * cells));
+      }
+      cell_of[i] = c;
+      cell_count[c]++;
+    }
+  });
+  std::vector<Node> cell_start(num_cells + 1, 0);
+  for (long long c = 0; c < num_cells; ++c) {
+    cell_start[c + 1] = cell_start[c] + cell_count[c];
+    cell_count[c] = cell_start[c];
+  }
+  std::vector<Node> ids(n);
+  ParallelFor(0, n, kPointGrain, [&](long long begin, long long end, long long) {
+    for (long long i = begin; i < end; ++i) {
+      ids[cell_count[cell_of[i]]++] = (Node)i;
+    }
+  });
+  cell_count.reset();
+  std::vector<Node>().swap(cell_of);
+
+  //scatter order is racy, sorting each cell keeps the output deterministic
+  std::vector<float> cell_points((size_t)n * dim);
+  ParallelFor(0, num_cells, kCellGrain, [&](long long begin, long long end, long long) {
+    for (long long c = begin; c < end; ++c) {
+      std::sort(ids.begin() + cell_start[c], ids.begin() + cell_start[c + 1]);
+      for (Node k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+        for (int d = 0; d < dim; ++d) {
+          cell_points[(size_t)k * dim + d] = points[(size_t)ids[k] * dim + d];
+        }
+      }
+    }
+  });
+  std::vector<float>().swap(points);
+
+  double radius2 = radius * radius;
+  int num_offsets = dim == 2 ? 9 : 27;
+  return BuildGraph<GraphT>(n, [&](auto emit) {
+    ParallelForSlice(num_cells, kCellGrain, [&](long long begin, long long end, long long block) {
+      auto engine = BlockEngine(edge_seed, block);
+      std::uniform_int_distribution<int> r_int(cmin, cmax);
+      int coord[3];
+      int neighbour[3];
+      for (long long c = begin; c < end; ++c) {
+        long long rest = c;
+        for (int d = dim - 1; d >= 0; --d) {
+          coord[d] = (int)(rest % cells);
+          rest /= cells;
+        }
+        for (Node k = cell_start[c]; k < cell_start[c + 1]; ++k) {
+          Node a = ids[k];
+          const float* pa = &cell_points[(size_t)k * dim];
+          for (int o = 0; o < num_offsets; ++o) {
+            Node nc = 0;
+            int offset = o;
+            bool inside = true;
+            for (int d = 0; d < dim; ++d) {
+              neighbour[d] = coord[d] + offset % 3 - 1;
+              offset /= 3;
+              inside = inside && neighbour[d] >= 0 && neighbour[d] < cells;
+              nc = nc * cells + neighbour[d];
+            }
+            if (!inside) {
+              continue;
+            }
+            for (Node k2 = cell_start[nc]; k2 < cell_start[nc + 1]; ++k2) {
+              Node b = ids[k2];
+              if (b == a || (!directed && b < a)) {
+                continue;
+              }
+              const float* pb = &cell_points[(size_t)k2 * dim];
+              double dist2 = 0;
+              for (int d = 0; d < dim; ++d) {
+                double delta = (double)pa[d] - pb[d];
+                dist2 += delta * delta;
+              }
+              if (dist2 <= radius2) {
+                emit(a, b, euclidean_cost ? EuclideanCost(std::sqrt(dist2), radius, cmin, cmax) : r_int(engine));
+              }
+            }
+          }
+        }
+      }
+    });
+  });
+}
+
+
+//Expected degrees following a power law with the given exponent, scaled to the average degree.
+std::vector<double> PowerLawWeights(long long n, double exponent, double avg_degree) {
+  std::vector<double> weights(n);
+  double sum = 0;
+  for (long long i = 0; i < n; ++i) {
+    weights[i] = std::pow(i + 1.0, -1 / (exponent - 1));
+    sum += weights[i];
+  }
+  for (auto& w : weights) {
+    w *= avg_degree * n / sum;
+  }
+  return weights;
+}
+
+//Vertices of a Chung-Lu graph in decreasing weight, with their weights in that order and the total.
+template <typename Node>
+struct ChungLuOrder {
+  std::vector<Node> order;
+  std::vector<double> w;
+  double total = 0;
+
+  explicit ChungLuOrder(const std::vector<double>& weights) : order(weights.size()), w(weights.size()) {
+    Node n = (Node)weights.size();
+    for (Node i = 0; i < n; ++i) {
+      order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](Node a, Node b) { return weights[a] > weights[b]; });
+    for (Node i = 0; i < n; ++i) {
+      w[i] = weights[order[i]];
+      total += w[i];
+    }
+  }
+};
+
+//Emits the edges of the vertices [begin, end) of the weight order, block `block` of kChungLuVertexGrain.
+//Vertices are visited in decreasing weight, so min(w_u * w_v / S, 1) only shrinks along a row and
+//each row is skip sampled with the current probability and thinned by q / p (Miller & Hagberg).
+template <typename Node, typename Emit>
+void ChungLuEdges(const ChungLuOrder<Node>& sorted, unsigned seed, int cmin, int cmax, long long begin, long long end, long long block, Emit emit) {
+  const std::vector<double>& w = sorted.w;
+  long long n = (long long)w.size();
+  auto engine = BlockEngine(seed, block);
+  std::uniform_int_distribution<int> r_int(cmin, cmax);
+  std::uniform_real_distribution<double> r_double(0, 1);
+  for (long long u = begin; u < end; ++u) {
+    long long v = u + 1;
+    double p = v < n ? std::min(w[u] * w[v] / sorted.total, 1.0) : 0;
+    while (v < n && p > 0) {
+      if (p < 1) {
+        v += GeometricSkip(engine, std::log(1 - p));
+      }
+      if (v < n) {
+        double q = std::min(w[u] * w[v] / sorted.total, 1.0);
+        if (r_double(engine) < q / p) {
+          emit(sorted.order[u], sorted.order[v], r_int(engine));
+        }
+        p = q;
+        v++;
+      }
+    }
+  }
+}
+
+//Chung-Lu graph, u and v are joined with probability min(w_u * w_v / sum(w), 1).
+template <typename GraphT>
+GraphT ChungLuGraph(const std::vector<double>& weights, std::default_random_engine random_engine, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  Node n = (Node)weights.size();
+  unsigned seed = random_engine();
+  ChungLuOrder<Node> sorted(weights);
+  return BuildGraph<GraphT>(n, [&](auto emit) {
+    ParallelForSlice(n, kChungLuVertexGrain, [&](long long begin, long long end, long long block) {
+      ChungLuEdges(sorted, seed, cmin, cmax, begin, end, block, emit);
+    });
+  });
+}
+
+//Chung-Lu graph written straight to out in parallel blocks of the weight order, the same edges ChungLuGraph
+//stores, grouped by their place in the weight order instead of by source.
+void StreamChungLuGraph(std::FILE* out, OutputFormat format, long long num_centers, const std::vector<double>& weights, std::default_random_engine random_engine, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  ChungLuOrder<long long> sorted(weights);
+  StreamGraph(out, format, (long long)weights.size(), num_centers, kChungLuVertexGrain, [&](long long begin, long long end, long long block, auto emit) {
+    ChungLuEdges(sorted, seed, cmin, cmax, begin, end, block, emit);
+  });
+}
+
+//Cursor of an EdgeRange over ChungLuEdges, the row of vertex u is walked one kept edge per step. The weight
+//order is shared by all copies.
+template <typename Node>
+class ChungLuCursor {
+public:
+  ChungLuCursor() {}
+  ChungLuCursor(std::shared_ptr<const ChungLuOrder<Node>> sorted, unsigned seed, int cmin, int cmax) : sorted(sorted), seed(seed), r_int(cmin, cmax) {}
+
+  bool next(Edge<Node>& edge) {
+    const std::vector<double>& w = sorted->w;
+    long long n = (long long)w.size();
+    for (;;) {
+      if (!in_row) {
+        if (u >= n) {
+          return false;
+        }
+        if (u % kChungLuVertexGrain == 0) {
+          engine = BlockEngine(seed, u / kChungLuVertexGrain);
+          r_int.reset();
+          r_double.reset();
+        }
+        v = u + 1;
+        p = v < n ? std::min(w[u] * w[v] / sorted->total, 1.0) : 0;
+        in_row = true;
+      }
+      if (v >= n || p <= 0) {
+        u++;
+        in_row = false;
+        continue;
+      }
+      if (p < 1) {
+        v += GeometricSkip(engine, std::log(1 - p));
+      }
+      if (v < n) {
+        double q = std::min(w[u] * w[v] / sorted->total, 1.0);
+        bool kept = r_double(engine) < q / p;
+        p = q;
+        long long dest = v++;
+        if (kept) {
+          edge.source = sorted->order[u];
+          edge.dest = sorted->order[dest];
+          edge.cost = r_int(engine);
+          return true;
+        }
+      }
+    }
+  }
+
+private:
+  std::shared_ptr<const ChungLuOrder<Node>> sorted;
+  unsigned seed = 0;
+  std::uniform_int_distribution<int> r_int;
+  std::uniform_real_distribution<double> r_double{ 0, 1 };
+  std::default_random_engine engine;
+  long long u = 0;
+  long long v = 0;
+  double p = 0;
+  bool in_row = false;
+};
+
+//The edges ChungLuGraph draws from the same engine, generated lazily. Only the weight order is stored.
+template <typename Node>
+EdgeRange<Node, ChungLuCursor<Node>> ChungLuEdgeRange(const std::vector<double>& weights, std::default_random_engine random_engine, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  auto sorted = std::make_shared<const ChungLuOrder<Node>>(weights);
+  return MakeEdgeRange<Node>(ChungLuCursor<Node>(sorted, seed, cmin, cmax));
+}
+
+//Stochastic block model, a node of block r links to a node of block s with probability probs[r][s].
+//Undirected graphs read only the upper triangle of probs. Every block is cut into row ranges that are
+//generated in parallel, each skip sampling its rows against every block.
+template <typename GraphT>
+GraphT StochasticBlockGraph(const std::vector<long long>& sizes, const std::vector<std::vector<double>>& probs, std::default_random_engine random_engine, bool directed, int cmin, int cmax) {
+  int num_blocks = (int)sizes.size();
+  unsigned seed = random_engine();
+  std::vector<long long> block_start(num_blocks + 1, 0);
+  for (int r = 0; r < num_blocks; ++r) {
+    block_start[r + 1] = block_start[r] + sizes[r];
+  }
+  //row ranges as (block, first row, last row)
+  std::vector<std::tuple<int, long long, long long>> tasks;
+  for (int r = 0; r < num_blocks; ++r) {
+    for (long long i = block_start[r]; i < block_start[r + 1]; i += kBlockModelRowGrain) {
+      tasks.emplace_back(r, i, std::min(i + kBlockModelRowGrain, block_start[r + 1]));
+    }
+  }
+
+  typedef typename GraphT::Node Node;
+  return BuildGraph<GraphT>((Node)block_start[num_blocks], [&](auto emit) {
+    ParallelForSlice(tasks.size(), 1, [&](long long task, long long, long long block) {
+      auto engine = BlockEngine(seed, block);
+      std::uniform_int_distribution<int> r_int(cmin, cmax);
+      int r = std::get<0>(tasks[task]);
+      long long begin = std::get<1>(tasks[task]);
+      long long end = std::get<2>(tasks[task]);
+      for (int s = directed ? 0 : r; s < num_blocks; ++s) {
+        SkipSamplePairs(begin, end, block_start[s], block_start[s + 1], !directed && s == r, probs[r][s], engine, [&](long long i, long long j) {
+          if (i != j) {
+            emit((Node)i, (Node)j, r_int(engine));
+          }
+        });
+      }
+    });
+  });
+}
+
+//Cursor of an EdgeRange over the row ranges of StochasticBlockGraph in the same order, each range skip
+//sampled against one block after the other. The block bounds and probabilities are shared by all copies.
+class BlockModelCursor {
+public:
+  BlockModelCursor() {}
+  BlockModelCursor(std::shared_ptr<const std::vector<long long>> block_start, std::shared_ptr<const std::vector<std::vector<double>>> probs, unsigned seed, bool directed, int cmin, int cmax)
+    : block_start(block_start), probs(probs), seed(seed), directed(directed), r_int(cmin, cmax) {}
+
+  template <typename Node>
+  bool next(Edge<Node>& edge) {
+    const std::vector<long long>& bounds = *block_start;
+    int num_blocks = (int)bounds.size() - 1;
+    for (;;) {
+      long long i;
+      long long j;
+      if (task >= 0 && sampler.next(engine, i, j)) {
+        if (i == j) {
+          continue;
+        }
+        edge.source = (Node)i;
+        edge.dest = (Node)j;
+        edge.cost = r_int(engine);
+        return true;
+      }
+      if (task >= 0 && ++s < num_blocks) {
+        sampler = PairSampler(begin, end, bounds[s], bounds[s + 1], !directed && s == r, (*probs)[r][s]);
+        continue;
+      }
+      //next row range, of this block or the next one with rows
+      begin = task >= 0 ? end : 0;
+      while (r < num_blocks && begin >= bounds[r + 1]) {
+        r++;
+        begin = r < num_blocks ? bounds[r] : begin;
+      }
+      if (r >= num_blocks) {
+        return false;
+      }
+      end = std::min(begin + kBlockModelRowGrain, bounds[r + 1]);
+      task++;
+      engine = BlockEngine(seed, task);
+      r_int.reset();
+      s = directed ? 0 : r;
+      sampler = PairSampler(begin, end, bounds[s], bounds[s + 1], !directed && s == r, (*probs)[r][s]);
+    }
+  }
+
+private:
+  std::shared_ptr<const std::vector<long long>> block_start;
+  std::shared_ptr<const std::vector<std::vector<double>>> probs;
+  unsigned seed = 0;
+  bool directed = false;
+  std::uniform_int_distribution<int> r_int;
+  long long task = -1;
+  int r = 0;
+  int s = 0;
+  long long begin = 0;
+  long long end = 0;
+  std::default_random_engine engine;
+  PairSampler sampler;
+};
+
+//The edges StochasticBlockGraph draws from the same engine, generated lazily.
+template <typename Node>
+EdgeRange<Node, BlockModelCursor> StochasticBlockEdgeRange(const std::vector<long long>& sizes, const std::vector<std::vector<double>>& probs, std::default_random_engine random_engine, bool directed, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  auto block_start = std::make_shared<std::vector<long long>>(sizes.size() + 1, 0);
+  for (size_t r = 0; r < sizes.size(); ++r) {
+    (*block_start)[r + 1] = (*block_start)[r] + sizes[r];
+  }
+  return MakeEdgeRange<Node>(BlockModelCursor(block_start, std::make_shared<const std::vector<std::vector<double>>>(probs), seed, directed, cmin, cmax));
+}
+
+//Watts-Strogatz graph, a ring where every node links to its k clockwise neighbours and each of these
+//links is rewired to a random node with probability beta. A rewired link never lands on the node itself
+//or on one of its other links, and a rewired link that meets a link of its target back to the node, a
+//lattice link or a link rewired from that end too, is redrawn afterwards, so the graph stays simple.
+//Directed, every node has arcs to its k neighbours on each side, each rewired on its own, and an arc
+//only has to avoid the other arcs of its source.
+template <typename GraphT>
+GraphT SmallWorldGraph(typename GraphT::Node n, std::default_random_engine random_engine, bool directed, int k, double beta, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  const long long kRowGrain = 1 << 14;
+  unsigned rewire_seed = random_engine();
+  unsigned conflict_seed = random_engine();
+  unsigned cost_seed = random_engine();
+  long long num_blocks = (n + kRowGrain - 1) / kRowGrain;
+  //links per node, the k clockwise ones and directed the k counterclockwise ones after them
+  int width = directed ? 2 * k : k;
+  std::vector<Node> targets((size_t)n * width);
+  std::vector<char> rewired((size_t)n * width, 0);
+  std::uniform_int_distribution<Node> r_node(0, n - 1);
+  auto target_slot = [&](long long u, Node w) {
+    for (long long slot = u * width; slot < (u + 1) * width; ++slot) {
+      if (targets[slot] == w) {
+        return slot;
+      }
+    }
+    return -1LL;
+  };
+  auto has_target = [&](long long u, Node w) {
+    return target_slot(u, w) >= 0;
+  };
+
+  ParallelFor(0, n, kRowGrain, [&](long long begin, long long end, long long block) {
+    auto engine = BlockEngine(rewire_seed, block);
+    for (long long u = begin; u < end; ++u) {
+      for (int j = 0; j < width; ++j) {
+        targets[u * width + j] = (Node)(j < k ? (u + j + 1) % n : (u + n - (j - k) - 1) % n);
+      }
+    }
+    SkipSamplePairs(begin, end, 0, width, false, beta, engine, [&](long long u, long long j) {
+      Node w;
+      do {
+        w = r_node(engine);
+      } while (w == u || has_target(u, w));
+      targets[u * width + j] = w;
+      rewired[u * width + j] = 1;
+    });
+  });
+
+  if (!directed) {
+    //u -> w rewired while w -> u is a lattice link, or rewired too and u is the larger end
+    std::vector<std::vector<long long>> conflicts(num_blocks);
+    ParallelFor(0, n, kRowGrain, [&](long long begin, long long end, long long block) {
+      for (long long slot = begin * width; slot < end * width; ++slot) {
+        if (!rewired[slot]) {
+          continue;
+        }
+        long long back = target_slot(targets[slot], (Node)(slot / width));
+        if (back >= 0 && (!rewired[back] || targets[slot] < slot / width)) {
+          conflicts[block].push_back(slot);
+        }
+      }
+    });
+    auto conflict_engine = BlockEngine(conflict_seed, 0);
+    for (auto& block_conflicts : conflicts) {
+      for (long long slot : block_conflicts) {
+        long long u = slot / width;
+        Node w;
+        do {
+          w = r_node(conflict_engine);
+        } while (w == u || has_target(u, w) || has_target(w, (Node)u));
+        targets[slot] = w;
+      }
+    }
+  }
+
+  GraphT G(n);
+  G.reserve_degrees(std::vector<Node>(n, (Node)width));
+  ParallelFor(0, n, kRowGrain, [&](long long begin, long long end, long long block) {
+    auto engine = BlockEngine(cost_seed, block);
+    std::uniform_int_distribution<int> r_int(cmin, cmax);
+    for (long long slot = begin * width; slot < end * width; ++slot) {
+      G.add_arc((Node)(slot / width), targets[slot], r_int(engine));
+    }
+  });
+  G.recount_edges();
+  return G;
+}
+
+
+//Configuration model, the stubs of all nodes are shuffled and paired up in order. With erase set the
+//self-loops and multi-edges this produces are dropped, so degrees become upper bounds.
+template <typename GraphT>
+GraphT ConfigurationGraph(const std::vector<int>& degrees, std::default_random_engine random_engine, bool erase, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  const long long kGrain = 1 << 14;
+  Node n = (Node)degrees.size();
+  unsigned shuffle_seed = random_engine();
+  unsigned cost_seed = random_engine();
+  std::vector<long long> stub_start(n + 1, 0);
+  for (Node i = 0; i < n; ++i) {
+    stub_start[i + 1] = stub_start[i] + degrees[i];
+  }
+  std::vector<Node> stubs(stub_start[n]);
+  ParallelFor(0, n, kGrain, [&](long long begin, long long end, long long) {
+    for (long long i = begin; i < end; ++i) {
+      std::fill(stubs.begin() + stub_start[i], stubs.begin() + stub_start[i + 1], (Node)i);
+    }
+  });
+  ParallelShuffle(stubs, shuffle_seed);
+
+  //pairs as (smaller, larger), sorting groups them by source and puts copies next to each other
+  std::vector<std::pair<Node, Node>> edges(stubs.size() / 2);
+  ParallelFor(0, edges.size(), kGrain, [&](long long begin, long long end, long long) {
+    for (long long e = begin; e < end; ++e) {
+      Node a = stubs[2 * e];
+      Node b = stubs[2 * e + 1];
+      edges[e] = a < b ? std::make_pair(a, b) : std::make_pair(b, a);
+    }
+  });
+  std::vector<Node>().swap(stubs);
+  ParallelSort(edges);
+
+  //a pair is kept unless erased, so the degrees are counted from the sorted pairs
+  auto kept = [&](size_t e) {
+    return !erase || (edges[e].first != edges[e].second && (e == 0 || edges[e - 1] != edges[e]));
+  };
+  std::vector<Node> out_degrees(n, 0);
+  ParallelFor(0, n, kGrain, [&](long long begin, long long end, long long) {
+    size_t e = std::lower_bound(edges.begin(), edges.end(), std::make_pair((Node)begin, (Node)0)) - edges.begin();
+    for (; e < edges.size() && edges[e].first < end; ++e) {
+      out_degrees[edges[e].first] += kept(e) ? 1 : 0;
+    }
+  });
+
+  return BuildGraph<GraphT>(n, out_degrees, [&](auto emit) {
+    ParallelForSlice(n, kGrain, [&](long long begin, long long end, long long block) {
+      auto engine = BlockEngine(cost_seed, block);
+      std::uniform_int_distribution<int> r_int(cmin, cmax);
+      auto first = std::lower_bound(edges.begin(), edges.end(), std::make_pair((Node)begin, (Node)0));
+      auto last = std::lower_bound(first, edges.end(), std::make_pair((Node)end, (Node)0));
+      for (auto it = first; it != last; ++it) {
+        if (kept(it - edges.begin())) {
+          emit(it->first, it->second, r_int(engine));
+        }
+      }
+    });
+  });
+}
+
+
+template <typename Node>
+struct HyperbolicPoint {
+  int band;
+  Node id;
+  double angle;
+  double cosh_r;
+  double sinh_r;
+  double cos_angle;
+  double sin_angle;
+
+  bool operator<(const HyperbolicPoint& other) const {
+    return std::tie(band, angle, id) < std::tie(other.band, other.angle, other.id);
+  }
+};
+
+//Threshold hyperbolic random graph (temperature 0) on a disk of radius R chosen for the average degree.
+//Points are sorted into radial bands and by angle within a band. A point only scans the angular range
+//of each band that can hold neighbours, bounded at the inner radius of the band (von Looz et al.).
+template <typename GraphT>
+GraphT HyperbolicGraph(typename GraphT::Node n, std::default_random_engine random_engine, bool directed, double avg_degree, double exponent, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  typedef HyperbolicPoint<Node> Point;
+  const long long kGrain = 1 << 12;
+  unsigned point_seed = random_engine();
+  unsigned edge_seed = random_engine();
+  double alpha = (exponent - 1) / 2;
+  double xi = alpha / (alpha - 0.5);
+  double radius = 2 * std::log(n * 2 * xi * xi / (kPi * avg_degree));
+  radius = std::max(radius, 1e-9);
+  double cosh_radius = std::cosh(radius);
+
+  //bands narrow towards the rim, where the points are dense
+  int num_bands = std::max(1, (int)std::ceil(std::log2(n) / 4));
+  std::vector<double> band_radius(num_bands + 1);
+  for (int i = 0; i <= num_bands; ++i) {
+    band_radius[i] = radius * (1 - std::pow(0.8, i)) / (1 - std::pow(0.8, num_bands));
+  }
+  band_radius[num_bands] = radius;
+  std::vector<double> band_cosh(num_bands);
+  std::vector<double> band_sinh(num_bands);
+  for (int i = 0; i < num_bands; ++i) {
+    band_cosh[i] = std::cosh(band_radius[i]);
+    band_sinh[i] = std::sinh(band_radius[i]);
+  }
+
+  std::vector<Point> points(n);
+  ParallelFor(0, n, kGrain, [&](long long begin, long long end, long long block) {
+    auto engine = BlockEngine(point_seed, block);
+    std::uniform_real_distribution<double> r_double(0, 1);
+    for (long long i = begin; i < end; ++i) {
+      Point& p = points[i];
+      p.id = (Node)i;
+      p.angle = 2 * kPi * r_double(engine);
+      double r = std::acosh(1 + (std::cosh(alpha * radius) - 1) * r_double(engine)) / alpha;
+      p.band = (int)(std::upper_bound(band_radius.begin(), band_radius.end(), r) - band_radius.begin()) - 1;
+      p.band = std::min(std::max(p.band, 0), num_bands - 1);
+      p.cosh_r = std::cosh(r);
+      p.sinh_r = std::sinh(r);
+      p.cos_angle = std::cos(p.angle);
+      p.sin_angle = std::sin(p.angle);
+    }
+  });
+  ParallelSort(points);
+  std::vector<Node> band_start(num_bands + 1, n);
+  for (int b = num_bands - 1; b >= 0; --b) {
+    Point key;
+    key.band = b;
+    key.angle = -1;
+    key.id = -1;
+    band_start[b] = (Node)(std::lower_bound(points.begin(), points.end(), key) - points.begin());
+  }
+
+  return BuildGraph<GraphT>(n, [&](auto emit) {
+    ParallelForSlice(n, kGrain, [&](long long begin, long long end, long long block) {
+      auto engine = BlockEngine(edge_seed, block);
+      std::uniform_int_distribution<int> r_int(cmin, cmax);
+      for (long long k = begin; k < end; ++k) {
+        const Point& p = points[k];
+        auto visit = [&](Node from, Node to) {
+          for (Node k2 = from; k2 < to; ++k2) {
+            const Point& q = points[k2];
+            if (q.id == p.id || (!directed && q.id < p.id)) {
+              continue;
+            }
+            double cos_delta = p.cos_angle * q.cos_angle + p.sin_angle * q.sin_angle;
+            if (p.cosh_r * q.cosh_r - p.sinh_r * q.sinh_r * cos_delta <= cosh_radius) {
+              emit(p.id, q.id, r_int(engine));
+            }
+          }
+        };
+        for (int b = 0; b < num_bands; ++b) {
+          //widest angle at which a point on the inner border of the band is still close enough
+          double max_delta = kPi;
+          if (band_radius[b] > 0) {
+            double c = (p.cosh_r * band_cosh[b] - cosh_radius) / (p.sinh_r * band_sinh[b]);
+            if (c > 1) {
+              continue;
+            }
+            if (c > -1) {
+              max_delta = std::acos(c);
+            }
+          }
+          auto by_angle = [](const Point& a, double angle) { return a.angle < angle; };
+          auto band_begin = points.begin() + band_start[b];
+          auto band_end = points.begin() + band_start[b + 1];
+          if (max_delta >= kPi) {
+            visit(band_start[b], band_start[b + 1]);
+            continue;
+          }
+          double low = p.angle - max_delta;
+          double high = p.angle + max_delta;
+          Node from = (Node)(std::lower_bound(band_begin, band_end, std::max(low, 0.0), by_angle) - points.begin());
+          Node to = (Node)(std::lower_bound(band_begin, band_end, std::min(high, 2 * kPi), by_angle) - points.begin());
+          visit(from, to);
+          if (low < 0) {
+            visit((Node)(std::lower_bound(band_begin, band_end, low + 2 * kPi, by_angle) - points.begin()), band_start[b + 1]);
+          }
+          if (high > 2 * kPi) {
+            visit(band_start[b], (Node)(std::lower_bound(band_begin, band_end, high - 2 * kPi, by_angle) - points.begin()));
+          }
+        }
+      }
+    });
+  });
+}
+
+
+//Emits the edges of the lattice vertices [begin, end). Ids are row major with the last dimension fastest and
+//neighbours are computed from the coordinates, so nothing is stored. Every vertex links to the next vertex
+//along each dimension, directed lattices also to the previous one, each link with probability density.
+template <typename Emit>
+void LatticeEdges(const std::vector<long long>& dims, bool torus, bool directed, double density, unsigned seed, unsigned cost_seed, int cmin, int cmax, long long begin, long long end, long long block, Emit emit) {
+  auto engine = BlockEngine(seed, block);
+  auto cost_engine = BlockEngine(cost_seed, block);
+  std::uniform_int_distribution<int> r_int(cmin, cmax);
+  std::uniform_real_distribution<double> r_double(0, 1);
+  int num_dims = (int)dims.size();
+  long long stride[kMaxLatticeDims];
+  long long coord[kMaxLatticeDims];
+  stride[num_dims - 1] = 1;
+  for (int d = num_dims - 2; d >= 0; --d) {
+    stride[d] = stride[d + 1] * dims[d + 1];
+  }
+  long long rest = begin;
+  for (int d = 0; d < num_dims; ++d) {
+    coord[d] = rest / stride[d];
+    rest %= stride[d];
+  }
+  auto link = [&](long long v, long long u) {
+    if (r_double(engine) < density) {
+      emit(v, u, r_int(cost_engine));
+    }
+  };
+
+  for (long long v = begin; v < end; ++v) {
+    for (int d = 0; d < num_dims; ++d) {
+      //a ring of two would link the same pair twice
+      bool wrap = torus && dims[d] > 2;
+      //next
+      if (coord[d] + 1 < dims[d]) {
+        link(v, v + stride[d]);
+      }
+      else if (wrap) {
+        link(v, v - (dims[d] - 1) * stride[d]);
+      }
+      //previous
+      if (directed) {
+        if (coord[d] > 0) {
+          link(v, v - stride[d]);
+        }
+        else if (wrap) {
+          link(v, v + (dims[d] - 1) * stride[d]);
+        }
+      }
+    }
+    for (int d = num_dims - 1; d >= 0 && ++coord[d] == dims[d]; --d) {
+      coord[d] = 0;
+    }
+  }
+}
+
+//d-dimensional grid or torus written straight to out in parallel slabs of vertices, without a Graph.
+void StreamLatticeGraph(std::FILE* out, OutputFormat format, long long num_centers, const std::vector<long long>& dims, std::default_random_engine random_engine, bool torus, bool directed, double density, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  unsigned cost_seed = random_engine();
+  long long n = 1;
+  for (long long size : dims) {
+    n *= size;
+  }
+  StreamGraph(out, format, n, num_centers, kLatticeSlabGrain, [&](long long begin, long long end, long long block, auto emit) {
+    LatticeEdges(dims, torus, directed, density, seed, cost_seed, cmin, cmax, begin, end, block, emit);
+  });
+}
+
+//Cursor of an EdgeRange over LatticeEdges, the links of a vertex are tried one dimension and direction at
+//a time and the coordinates are carried from vertex to vertex.
+class LatticeCursor {
+public:
+  LatticeCursor() {}
+  LatticeCursor(const std::vector<long long>& sizes, bool torus, bool directed, double density, unsigned seed, unsigned cost_seed, int cmin, int cmax)
+    : num_dims((int)sizes.size()), torus(torus), directed(directed), density(density), seed(seed), cost_seed(cost_seed), r_int(cmin, cmax) {
+    for (int d = num_dims - 1; d >= 0; --d) {
+      dims[d] = sizes[d];
+      stride[d] = d == num_dims - 1 ? 1 : stride[d + 1] * dims[d + 1];
+      coord[d] = 0;
+    }
+    n = num_dims > 0 ? stride[0] * dims[0] : 0;
+  }
+
+  template <typename Node>
+  bool next(Edge<Node>& edge) {
+    while (v < n) {
+      if (d == 0 && !previous && v % kLatticeSlabGrain == 0) {
+        engine = BlockEngine(seed, v / kLatticeSlabGrain);
+        cost_engine = BlockEngine(cost_seed, v / kLatticeSlabGrain);
+        r_int.reset();
+        r_double.reset();
+      }
+      long long source = v;
+      long long dest = -1;
+      //a ring of two would link the same pair twice
+      bool wrap = torus && dims[d] > 2;
+      if (!previous) {
+        dest = coord[d] + 1 < dims[d] ? v + stride[d] : wrap ? v - (dims[d] - 1) * stride[d] : -1;
+      }
+      else {
+        dest = coord[d] > 0 ? v - stride[d] : wrap ? v + (dims[d] - 1) * stride[d] : -1;
+      }
+      if (directed && !previous) {
+        previous = true;
+      }
+      else {
+        previous = false;
+        if (++d == num_dims) {
+          d = 0;
+          v++;
+          for (int c = num_dims - 1; c >= 0 && ++coord[c] == dims[c]; --c) {
+            coord[c] = 0;
+          }
+        }
+      }
+      if (dest >= 0 && r_double(engine) < density) {
+        edge.source = (Node)source;
+        edge.dest = (Node)dest;
+        edge.cost = r_int(cost_engine);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  int num_dims = 0;
+  long long dims[kMaxLatticeDims] = {};
+  long long stride[kMaxLatticeDims] = {};
+  long long coord[kMaxLatticeDims] = {};
+  long long n = 0;
+  bool torus = false;
+  bool directed = false;
+  double density = 0;
+  unsigned seed = 0;
+  unsigned cost_seed = 0;
+  std::uniform_int_distribution<int> r_int;
+  std::uniform_real_distribution<double> r_double{ 0, 1 };
+  std::default_random_engine engine;
+  std::default_random_engine cost_engine;
+  long long v = 0;
+  int d = 0;
+  bool previous = false;
+};
+
+//The edges StreamLatticeGraph writes for the same engine, generated lazily.
+template <typename Node>
+EdgeRange<Node, LatticeCursor> LatticeEdgeRange(const std::vector<long long>& dims, std::default_random_engine random_engine, bool torus, bool directed, double density, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  unsigned cost_seed = random_engine();
+  return MakeEdgeRange<Node>(LatticeCursor(dims, torus, directed, density, seed, cost_seed, cmin, cmax));
+}
+
+//Road network like planar graph, the Delaunay triangulation of random points in the unit square thinned
+//to density. Costs grow with edge length and reach cmax at twice the typical spacing of the points.
+//The triangulation numbers points with int, so n stays below 2^31 whatever the node type.
+template <typename GraphT>
+GraphT PlanarGraph(int n, std::default_random_engine random_engine, bool directed, double density, int cmin, int cmax) {
+  const long long kGrain = 1 << 14;
+  const long long kCoordRange = 1 << 20;
+  unsigned point_seed = random_engine();
+  unsigned duplicate_seed = random_engine();
+  unsigned edge_seed = random_engine();
+  std::vector<Delaunay::Point> points(n);
+  ParallelFor(0, n, kGrain, [&](long long begin, long long end, long long block) {
+    auto engine = BlockEngine(point_seed, block);
+    std::uniform_int_distribution<long long> r_coord(0, kCoordRange - 1);
+    for (long long i = begin; i < end; ++i) {
+      points[i].x = r_coord(engine);
+      points[i].y = r_coord(engine);
+      points[i].id = (int)i;
+    }
+  });
+  //the triangulation needs distinct points, the rare duplicates are drawn again
+  auto duplicate_engine = BlockEngine(duplicate_seed, 0);
+  std::uniform_int_distribution<long long> r_coord(0, kCoordRange - 1);
+  for (bool duplicates = true; duplicates;) {
+    ParallelSort(points);
+    duplicates = false;
+    for (int i = 1; i < n; ++i) {
+      if (points[i].x == points[i - 1].x && points[i].y == points[i - 1].y) {
+        points[i].x = r_coord(duplicate_engine);
+        points[i].y = r_coord(duplicate_engine);
+        duplicates = true;
+      }
+    }
+  }
+
+  std::vector<std::pair<int, int>> triangulation = Delaunay::Triangulate(points);
+  std::vector<unsigned long long> arcs(directed ? 2 * triangulation.size() : triangulation.size());
+  ParallelFor(0, triangulation.size(), kGrain, [&](long long begin, long long end, long long) {
+    for (long long e = begin; e < end; ++e) {
+      unsigned long long a = (unsigned)triangulation[e].first;
+      unsigned long long b = (unsigned)triangulation[e].second;
+      if (directed) {
+        arcs[2 * e] = a << 32 | b;
+        arcs[2 * e + 1] = b << 32 | a;
+      }
+      else {
+        arcs[e] = a < b ? a << 32 | b : b << 32 | a;
+      }
+    }
+  });
+  std::vector<std::pair<int, int>>().swap(triangulation);
+  ParallelSort(arcs);
+
+  std::vector<int> position(n);
+  for (int i = 0; i < n; ++i) {
+    position[points[i].id] = i;
+  }
+  double spacing = 2 * kCoordRange / std::sqrt((double)n);
+  return BuildGraph<GraphT>(n, [&](auto emit) {
+    ParallelForSlice(n, kGrain, [&](long long begin, long long end, long long block) {
+      auto engine = BlockEngine(edge_seed, block);
+      std::uniform_real_distribution<double> r_double(0, 1);
+      auto first = std::lower_bound(arcs.begin(), arcs.end(), (unsigned long long)begin << 32);
+      auto last = std::lower_bound(first, arcs.end(), (unsigned long long)end << 32);
+      for (auto it = first; it != last; ++it) {
+        if (r_double(engine) < density) {
+          const Delaunay::Point& a = points[position[*it >> 32]];
+          const Delaunay::Point& b = points[position[*it & 0xffffffffu]];
+          double length = std::hypot((double)(a.x - b.x), (double)(a.y - b.y));
+          emit(a.id, b.id, EuclideanCost(length, spacing, cmin, cmax));
+        }
+      }
+    });
+  });
+}
+
+//Random bipartite graph, nodes [0, left) link to nodes [left, n) with probability density. With no_isolated set,
+//nodes left without an edge are given one to a random node of the other side afterwards.
+template <typename GraphT>
+GraphT BipartiteGraph(typename GraphT::Node n, typename GraphT::Node left, std::default_random_engine random_engine, double density, bool no_isolated, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  unsigned seed = random_engine();
+  unsigned fix_seed = random_engine();
+  //right nodes reached by some edge, marked while the edges are drawn
+  std::unique_ptr<std::atomic<bool>[]> covered(no_isolated ? new std::atomic<bool>[n - left]() : nullptr);
+  GraphT G = BuildGraph<GraphT>(n, [&](auto emit) {
+    ParallelForSlice(left, kBipartiteRowGrain, [&](long long begin, long long end, long long block) {
+      auto engine = BlockEngine(seed, block);
+      std::uniform_int_distribution<int> r_int(cmin, cmax);
+      std::uniform_int_distribution<Node> r_right(left, n - 1);
+      std::vector<bool> has_edge(end - begin, false);
+      SkipSamplePairs(begin, end, left, n, false, density, engine, [&](long long i, long long j) {
+        emit((Node)i, (Node)j, r_int(engine));
+        has_edge[i - begin] = true;
+        if (no_isolated) {
+          covered[j - left].store(true, std::memory_order_relaxed);
+        }
+      });
+      if (no_isolated) {
+        for (long long i = begin; i < end; ++i) {
+          if (!has_edge[i - begin]) {
+            Node j = r_right(engine);
+            emit((Node)i, j, r_int(engine));
+            covered[j - left].store(true, std::memory_order_relaxed);
+          }
+        }
+      }
+    });
+  });
+
+  if (no_isolated) {
+    auto engine = BlockEngine(fix_seed, 0);
+    std::uniform_int_distribution<int> r_int(cmin, cmax);
+    std::uniform_int_distribution<Node> r_left(0, left - 1);
+    for (Node j = left; j < n; ++j) {
+      if (!covered[j - left]) {
+        G.add_arc(r_left(engine), j, r_int(engine));
+      }
+    }
+  }
+  G.recount_edges();
+  return G;
+}
+
+
+//The edges BipartiteGraph draws from the same engine without no_isolated, generated lazily.
+template <typename Node>
+EdgeRange<Node, SkipSampleCursor> BipartiteEdgeRange(Node n, Node left, std::default_random_engine random_engine, double density, int cmin, int cmax) {
+  unsigned seed = random_engine();
+  return MakeEdgeRange<Node>(SkipSampleCursor(seed, left, left, n, false, density, kBipartiteRowGrain, cmin, cmax));
+}
+
+//Directed graph that grows one node at a time, for the evolving models. The out-links of a node are
+//added while it is the newest node, so they sit contiguously in a CSR array. In-links reach older nodes
+//at any time and are kept as singly linked lists threaded through per-arc arrays.
+template <typename Node, typename Count>
+class GrowingGraph {
+public:
+  std::vector<Count> out_start;
+  std::vector<Node> out_dest;
+  std::vector<Node> arc_source;
+  std::vector<Count> in_head;
+  std::vector<Count> in_next;
+
+  GrowingGraph(Node n, size_t expected_arcs) : in_head(n, -1) {
+    out_start.reserve((size_t)n + 1);
+    out_start.push_back(0);
+    out_dest.reserve(expected_arcs);
+    arc_source.reserve(expected_arcs);
+    in_next.reserve(expected_arcs);
+  }
+
+  //the node whose out-links are being added
+  Node newest() const {
+    return (Node)out_start.size() - 1;
+  }
+
+  void add_arc(Node dest) {
+    in_next.push_back(in_head[dest]);
+    in_head[dest] = (Count)out_dest.size();
+    out_dest.push_back(dest);
+    arc_source.push_back(newest());
+  }
+
+  void close_node() {
+    out_start.push_back((Count)out_dest.size());
+  }
+
+  //costs are drawn per block of sources, so they do not depend on the number of threads
+  template <typename GraphT>
+  GraphT to_graph(unsigned seed, int cmin, int cmax) const {
+    const long long kVertexGrain = 1 << 14;
+    GraphT G(newest());
+    std::vector<Node> degrees(newest());
+    for (Node i = 0; i < newest(); ++i) {
+      degrees[i] = (Node)(out_start[i + 1] - out_start[i]);
+    }
+    G.reserve_degrees(degrees);
+    ParallelFor(0, newest(), kVertexGrain, [&](long long begin, long long end, long long block) {
+      auto engine = BlockEngine(seed, block);
+      std::uniform_int_distribution<int> r_int(cmin, cmax);
+      for (long long i = begin; i < end; ++i) {
+        for (Count e = out_start[i]; e < out_start[i + 1]; ++e) {
+          G.add_arc((Node)i, out_dest[e], r_int(engine));
+        }
+      }
+    });
+    G.recount_edges();
+    return G;
+  }
+};
+
+//Moves `count` random items of buffer to its front, a partial Fisher-Yates shuffle.
+template <typename T>
+void SampleFront(std::vector<T>& buffer, size_t count, std::default_random_engine& random_engine) {
+  for (size_t i = 0; i < count; ++i) {
+    std::uniform_int_distribution<size_t> r_index(i, buffer.size() - 1);
+    std::swap(buffer[i], buffer[r_index(random_engine)]);
+  }
+}
+
+//Forest fire model (Leskovec et al.), directed. A new node links to a random ambassador and spreads from
+//every node it reaches to a geometric number of its unburned out-links (mean p / (1 - p)) and in-links
+//(mean rp / (1 - rp)), linking to each. Burned nodes are stamped with the new node in an epoch array and the
+//queue and candidate buffers are reused, so a step allocates nothing.
+template <typename GraphT>
+GraphT ForestFireGraph(typename GraphT::Node n, std::default_random_engine random_engine, double forward, double backward_ratio, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  typedef typename GraphT::Count Count;
+  unsigned cost_seed = random_engine();
+  GrowingGraph<Node, Count> growing(n, (size_t)n * 4);
+  std::geometric_distribution<int> r_forward(1 - forward);
+  std::geometric_distribution<int> r_backward(1 - forward * backward_ratio);
+  std::vector<Node> burned(n, -1);
+  std::vector<Node> queue;
+  std::vector<Node> candidates;
+  queue.reserve(n);
+
+  growing.close_node();
+  for (Node v = 1; v < n; ++v) {
+    std::uniform_int_distribution<Node> r_ambassador(0, v - 1);
+    Node ambassador = r_ambassador(random_engine);
+    burned[v] = v;
+    burned[ambassador] = v;
+    growing.add_arc(ambassador);
+    queue.clear();
+    queue.push_back(ambassador);
+    for (size_t head = 0; head < queue.size(); ++head) {
+      Node u = queue[head];
+      int spread_out = r_forward(random_engine);
+      int spread_in = r_backward(random_engine);
+
+      //spreading is usually zero, skip the scan then, hubs have long in-lists
+      candidates.clear();
+      for (Count e = growing.out_start[u]; spread_out > 0 && e < growing.out_start[u + 1]; ++e) {
+        if (burned[growing.out_dest[e]] != v) {
+          candidates.push_back(growing.out_dest[e]);
+        }
+      }
+      size_t count = std::min(candidates.size(), (size_t)spread_out);
+      SampleFront(candidates, count, random_engine);
+      for (size_t c = 0; c < count; ++c) {
+        burned[candidates[c]] = v;
+        queue.push_back(candidates[c]);
+      }
+
+      //collected before linking, linking prepends v to the in-lists
+      candidates.clear();
+      for (Count e = spread_in > 0 ? growing.in_head[u] : -1; e >= 0; e = growing.in_next[e]) {
+        if (burned[growing.arc_source[e]] != v) {
+          candidates.push_back(growing.arc_source[e]);
+        }
+      }
+      count = std::min(candidates.size(), (size_t)spread_in);
+      SampleFront(candidates, count, random_engine);
+      for (size_t c = 0; c < count; ++c) {
+        burned[candidates[c]] = v;
+        queue.push_back(candidates[c]);
+      }
+    }
+    for (size_t q = 1; q < queue.size(); ++q) {
+      growing.add_arc(queue[q]);
+    }
+    growing.close_node();
+  }
+
+  return growing.template to_graph<GraphT>(cost_seed, cmin, cmax);
+}
+
+//Copying model (Kleinberg et al.), directed. Every new node picks a random prototype and makes `degree`
+//links; link i goes to a uniform random node with probability beta and copies the prototype's i-th
+//out-link otherwise. Links that repeat a target of the same node are redrawn uniformly.
+template <typename GraphT>
+GraphT CopyingGraph(typename GraphT::Node n, std::default_random_engine random_engine, int degree, double beta, int cmin, int cmax) {
+  typedef typename GraphT::Node Node;
+  typedef typename GraphT::Count Count;
+  unsigned cost_seed = random_engine();
+  GrowingGraph<Node, Count> growing(n, (size_t)n * degree);
+  std::uniform_real_distribution<double> r_double(0, 1);
+  std::vector<Node> linked(n, -1);
+
+  growing.close_node();
+  for (Node v = 1; v < n; ++v) {
+    std::uniform_int_distribution<Node> r_node(0, v - 1);
+    Node prototype = r_node(random_engine);
+    Count prototype_degree = growing.out_start[prototype + 1] - growing.out_start[prototype];
+    Node links = std::min<Node>(degree, v);
+    for (Node i = 0; i < links; ++i) {
+      Node target;
+      if (i < prototype_degree && r_double(random_engine) >= beta) {
+        target = growing.out_dest[growing.out_start[prototype] + i];
+      }
+      else {
+        target = r_node(random_engine);
+      }
+      while (linked[target] == v) {
+        target = r_node(random_engine);
+      }
+      linked[target] = v;
+      growing.add_arc(target);
+    }
+    growing.close_node();
+  }
+
+  return growing.template to_graph<GraphT>(cost_seed, cmin, cmax);
+}
@@ -1,23 +1,48 @@
 #include "stdafx.h" //precompiled header
 #include "Graph.hpp"
-
-enum OutputFormat {
-  kPajek,
-  kPmed,
-};
+#include "Plan.hpp"
+#include "Batch.hpp"
+#include "Server.hpp"
+#include "Benchmark.hpp"
 
 enum GeneratorType {
   kSimpleConnectedRandom,
   kRandom,
   kGrid,
-  kScaleFree
+  kScaleFree,
+  kGeometric,
+  kChungLu,
+  kStochasticBlock,
+  kSmallWorld,
+  kConfiguration,
+  kRegular,
+  kHyperbolic,
+  kLattice,
+  kPlanar,
+  kBipartite,
+  kHolmeKim,
+  kForestFire,
+  kCopying
 };
 
 static std::map<std::string, GeneratorType> kGeneratorTypeMap{
   {"csrandom",  kSimpleConnectedRandom},
   {"random",    kRandom},
   {"grid",      kGrid},
-  {"scalefree", kScaleFree}
+  {"scalefree", kScaleFree},
+  {"geometric", kGeometric},
+  {"chunglu",   kChungLu},
+  {"sbm",       kStochasticBlock},
+  {"smallworld", kSmallWorld},
+  {"configuration", kConfiguration},
+  {"regular",   kRegular},
+  {"hyperbolic", kHyperbolic},
+  {"lattice",   kLattice},
+  {"planar",    kPlanar},
+  {"bipartite", kBipartite},
+  {"holmekim",  kHolmeKim},
+  {"forestfire", kForestFire},
+  {"copying",   kCopying}
 };
 
 static std::map<std::string, OutputFormat> kOutputFormatTypeMap{
@@ -25,70 +50,759 @@ static std::map<std::string, OutputFormat> kOutputFormatTypeMap{
   {"pmed",  kPmed }
 };
 
+static std::map<std::string, HugePages> kHugePagesTypeMap{
+  {"off",         kHugePagesOff },
+  {"transparent", kHugePagesTransparent },
+  {"explicit",    kHugePagesExplicit }
+};
 
+static std::map<std::string, OutputBackend> kOutputBackendTypeMap{
+  {"stdio", kStdioOutput },
+  {"uring", kUringOutput }
+};
 
-int kNumNodes;
-double kDensity;
-int kNumCenters;
-OutputFormat kOutFormat;
-GeneratorType kGenType;
-std::default_random_engine kRandomEngine;
-Graph generated_graph;
-bool kDebug = false;
-bool kDirected = true;
-int kScaleFreeInitialNodes = 2;
-int kScaleFreeMinDegree = 1;
-double kScaleFreeOffsetExponent = 1.0;
-int kMinCost = 1;
-int kMaxCost = 100;
+//generators whose fill draws every block of sources from its own stream, so --num-ranks can split them
+static std::set<GeneratorType> kSlicedTypes{
+  kRandom, kGeometric, kChungLu, kStochasticBlock, kConfiguration, kRegular, kHyperbolic, kLattice, kPlanar, kBipartite
+};
 
-int main(int argc, const char* argv[]) {
+
+
+//Settings of the graph being generated, one copy per thread so the jobs of a batch run side by side. Their
+//defaults are set by ResetSettings.
+thread_local long long kNumNodes;
+thread_local double kDensity;
+thread_local long long kNumCenters;
+thread_local OutputFormat kOutFormat;
+thread_local GeneratorType kGenType;
+thread_local std::default_random_engine kRandomEngine;
+thread_local bool kDebug;
+thread_local bool kDirected;
+thread_local int kMinCost;
+thread_local int kMaxCost;
+thread_local int kIdBits;
+thread_local int kWeightBits;
+thread_local bool kExternal;
+thread_local bool kSimple;
+thread_local double kMaxMemory;
+thread_local bool kPlan;
+//the plan asked for with --plan, written in place of the graph
+thread_local std::string kPlanText;
+//set by the plan for generators that can write the graph without storing it
+thread_local bool kStream;
+thread_local int kScaleFreeInitialNodes;
+thread_local int kScaleFreeMinDegree;
+thread_local double kScaleFreeOffsetExponent;
+thread_local int kGeometricDim;
+thread_local double kGeometricRadius;
+thread_local bool kGeometricEuclideanCost;
+thread_local double kChungLuExponent;
+thread_local double kChungLuAvgDegree;
+thread_local std::vector<double> kChungLuWeights;
+thread_local std::vector<long long> kBlockSizes;
+thread_local std::vector<std::vector<double>> kBlockProbs;
+thread_local int kSmallWorldNeighbours;
+thread_local double kSmallWorldRewire;
+thread_local std::vector<int> kDegrees;
+thread_local bool kConfigurationErase;
+thread_local double kHyperbolicAvgDegree;
+thread_local double kHyperbolicExponent;
+thread_local std::vector<long long> kLatticeDims;
+thread_local bool kLatticeTorus;
+thread_local long long kBipartiteLeft;
+thread_local bool kBipartiteNoIsolated;
+thread_local int kHolmeKimInitialNodes;
+thread_local int kHolmeKimEdges;
+thread_local double kHolmeKimTriad;
+thread_local double kForestFireForward;
+thread_local double kForestFireBackward;
+thread_local int kCopyingDegree;
+thread_local double kCopyingRandom;
+
+//Puts the settings of this thread back to their defaults. Every parse starts with it, a batch worker runs
+//one job after the other and a job must not inherit the options of the one before.
+void ResetSettings() {
+  kNumNodes = 0;
+  kDensity = 0;
+  kNumCenters = 0;
+  kOutFormat = kPajek;
+  kGenType = kSimpleConnectedRandom;
+  kRandomEngine = std::default_random_engine();
+  kDebug = false;
+  kDirected = true;
+  kMinCost = 1;
+  kMaxCost = 100;
+  kIdBits = 32;
+  kWeightBits = 32;
+  kExternal = false;
+  kSimple = false;
+  kMaxMemory = 0;
+  kPlan = false;
+  kPlanText.clear();
+  kStream = false;
+  kScaleFreeInitialNodes = 2;
+  kScaleFreeMinDegree = 1;
+  kScaleFreeOffsetExponent = 1.0;
+  kGeometricDim = 2;
+  kGeometricRadius = 0;
+  kGeometricEuclideanCost = false;
+  kChungLuExponent = 2.5;
+  kChungLuAvgDegree = 0;
+  kChungLuWeights.clear();
+  kBlockSizes.clear();
+  kBlockProbs.clear();
+  kSmallWorldNeighbours = 0;
+  kSmallWorldRewire = 0.1;
+  kDegrees.clear();
+  kConfigurationErase = false;
+  kHyperbolicAvgDegree = 0;
+  kHyperbolicExponent = 3.0;
+  kLatticeDims.clear();
+  kLatticeTorus = false;
+  kBipartiteLeft = 0;
+  kBipartiteNoIsolated = false;
+  kHolmeKimInitialNodes = 3;
+  kHolmeKimEdges = 2;
+  kHolmeKimTriad = 0.5;
+  kForestFireForward = 0.37;
+  kForestFireBackward = 0.32;
+  kCopyingDegree = 4;
+  kCopyingRandom = 0.2;
+  Spill() = SpillDefaults();
+  OutputError().clear();
+  Stats() = RunStats();
+}
+
+//options of the jobs of a batch and the output file name pattern, empty outside batch mode
+std::vector<std::vector<std::string>> kBatchJobs;
+std::string kOutputPattern;
+//--max-memory and --plan of the command line, every job starts from them
+double kDefaultMaxMemory = 0;
+bool kDefaultPlan = false;
+//Unix socket the daemon listens on, empty when generating a single graph
+std::string kServePath;
+bool kBenchmark = false;
+std::string kBenchmarkBaseline;
+
+//Cases of --benchmark, every generator at a small and a large size, written as pajek and as pmed. The whole
+//suite takes a few minutes on one core.
+const char* kBenchmarkSuite[] = {
+  "-t random -n 10000 -p 0.001 -f {pajek,pmed} -s 1",
+  "-t random -n 1000000 -p 0.000004 -f {pajek,pmed} -s 1",
+  "-t csrandom -n {1000,5000} -p 0.01 -f {pajek,pmed} -s 1",
+  "-t grid -n {10000,1000000} -p 0.9 -f {pajek,pmed} -s 1",
+  "-t scalefree -n {2000,10000} -p 0.1 -f {pajek,pmed} -s 1",
+  "-t geometric -n {10000,1000000} -p 0.00001 -f {pajek,pmed} -s 1",
+  "-t chunglu -n {10000,1000000} -p 0.1 --chunglu_avg_degree 4 -f {pajek,pmed} -s 1",
+  "-t sbm -n 1000000 -p 0.1 --sbm_sizes 500000,500000 --sbm_probs 0.000004,0.0000004;0.0000004,0.000004 -f {pajek,pmed} -s 1",
+  "-t smallworld -n {10000,1000000} -p 0.1 --smallworld_neighbours 2 -f {pajek,pmed} -s 1",
+  "-t regular -n {10000,1000000} -p 0.1 --regular_degree 4 -f {pajek,pmed} -s 1",
+  "-t hyperbolic -n {10000,500000} -p 0.1 --hyperbolic_avg_degree 6 -f {pajek,pmed} -s 1",
+  "-t lattice -n {8000,1000000} -p 0.8 -f {pajek,pmed} -s 1",
+  "-t planar -n {10000,300000} -p 0.9 -f {pajek,pmed} -s 1",
+  "-t bipartite -n {10000,1000000} -p 0.00001 -f {pajek,pmed} -s 1",
+  "-t holmekim -n {10000,300000} -p 0.1 -f {pajek,pmed} -s 1",
+  "-t forestfire -n {10000,300000} -p 0.1 -f {pajek,pmed} -s 1",
+  "-t copying -n {10000,300000} -p 0.1 -f {pajek,pmed} -s 1",
+  "-t random -n 1000000 -p 0.000004 -f {pajek,pmed} -s 1 --external",
+  "-t random -n 1000000 -p 0.000004 -f {pajek,pmed} -s 1 --simple",
+};
+
+//Thrown in place of exiting when a daemon request is invalid, the error text is in the request's Errors().
+struct RequestError {};
+thread_local std::ostream* kErrors = &std::cerr;
+thread_local bool kInRequest = false;
+
+std::ostream& Errors() {
+  return *kErrors;
+}
+
+//Ends the run after an error, or only the daemon request that caused it.
+[[noreturn]] void Fail(int code) {
+  if (kInRequest) {
+    throw RequestError();
+  }
+  exit(code);
+}
+
+//Adds the jobs of a batch line, --sweep or benchmark case to the batch.
+void AddJobs(const std::string& line) {
+  std::string error;
+  if (!ExpandSweep(line, kBatchJobs, error)) {
+    Errors() << error << std::endl;
+    Fail(2);
+  }
+}
+
+template <typename T>
+std::vector<T> ParseList(const std::string& text, char separator) {
+  std::vector<T> values;
+  std::stringstream in(text);
+  std::string item;
+  while (std::getline(in, item, separator)) {
+    std::stringstream item_in(item);
+    T value;
+    if (!(item_in >> value)) {
+      Errors() << "Invalid list value: " << item << std::endl;
+      Fail(2);
+    }
+    values.push_back(value);
+  }
+  return values;
+}
+
+//Expected edges and memory of the generator picked on the command line, see Plan.hpp. Undirected
+//generators store each edge once.
+Estimate EstimateRun() {
+  Estimate e;
+  double n = (double)kNumNodes;
+  double id_bytes = kIdBits / 8;
+  double pairs = kDirected ? n * n : n * (n - 1) / 2;
+  e.nodes = n;
+  e.format = kOutFormat;
+  switch (kGenType) {
+  case kSimpleConnectedRandom: {
+    e.arcs = std::max(n - 1, kDensity * n * (n - 1) / 2);
+    double slots = 16;
+    while (slots < 2 * e.arcs) {
+      slots *= 2;
+    }
+    //the edge set, then its sorted copy
+    e.aux_bytes = std::min(slots * 2 * id_bytes, n * n / 8) + e.arcs * 2 * id_bytes + n / 8;
+    e.arc_seconds = 3e-7;
+    e.parallel = false;
+    e.grows_lists = true;
+    e.keeps_arcs = true;
+    break;
+  }
+  case kRandom:
+    e.arcs = kDensity * pairs;
+    e.buffers_arcs = true;
+    e.can_stream = !kSimple;
+    break;
+  case kGrid:
+    e.arcs = kDensity * (kDirected ? 4 : 2) * n;
+    //the lists are sized for every neighbour, the arcs not drawn leave their room empty
+    e.aux_bytes = (1 - kDensity) * (kDirected ? 4 : 2) * n * (id_bytes + kWeightBits / 8) + n * id_bytes;
+    e.parallel = false;
+    break;
+  case kScaleFree:
+    e.arcs = kScaleFreeInitialNodes * (kScaleFreeInitialNodes - 1) / 2.0 + (n - kScaleFreeInitialNodes) * kScaleFreeMinDegree;
+    e.aux_bytes = 2 * n * id_bytes;
+    //candidates are drawn uniformly and accepted by degree, about one in i
+    e.extra_seconds = 2e-8 * n * n * kScaleFreeMinDegree;
+    e.parallel = false;
+    e.grows_lists = true;
+    break;
+  case kGeometric: {
+    double volume = kGeometricDim == 2 ? kPi * kGeometricRadius * kGeometricRadius : 4 * kPi * std::pow(kGeometricRadius, 3) / 3;
+    e.arcs = std::min(1.0, volume) * pairs;
+    e.aux_bytes = n * (8 * kGeometricDim + 2 * id_bytes);
+    e.arc_seconds = 1.5e-7;
+    e.buffers_arcs = true;
+    break;
+  }
+  case kChungLu: {
+    double total = 0;
+    for (double w : kChungLuWeights) {
+      total += w;
+    }
+    e.arcs = total / 2;
+    //the weights, sorted and in order
+    e.aux_bytes = n * (24 + id_bytes);
+    e.arc_seconds = 3e-7;
+    e.buffers_arcs = true;
+    e.can_stream = !kSimple;
+    break;
+  }
+  case kStochasticBlock:
+    e.arcs = 0;
+    for (size_t r = 0; r < kBlockSizes.size(); ++r) {
+      for (size_t s = kDirected ? 0 : r; s < kBlockSizes.size(); ++s) {
+        double size_r = (double)kBlockSizes[r];
+        double size_s = (double)kBlockSizes[s];
+        e.arcs += kBlockProbs[r][s] * (!kDirected && r == s ? size_r * (size_r - 1) / 2 : size_r * size_s);
+      }
+    }
+    e.buffers_arcs = true;
+    break;
+  case kSmallWorld:
+    e.arcs = n * kSmallWorldNeighbours * (kDirected ? 2 : 1);
+    e.aux_bytes = e.arcs * (id_bytes + 1);
+    break;
+  case kConfiguration:
+  case kRegular: {
+    double stubs = 0;
+    for (int degree : kDegrees) {
+      stubs += degree;
+    }
+    e.arcs = stubs / 2;
+    //the stubs, then the pairs and the buffer of their sort, and the degrees counted from the pairs
+    e.aux_bytes = stubs * id_bytes + 2 * e.arcs * 2 * id_bytes + n * id_bytes;
+    e.arc_seconds = 2e-7;
+    break;
+  }
+  case kHyperbolic:
+    e.arcs = kHyperbolicAvgDegree * n / (kDirected ? 1 : 2);
+    e.aux_bytes = n * (32 + id_bytes);
+    e.arc_seconds = 2e-7;
+    e.buffers_arcs = true;
+    break;
+  case kLattice:
+    e.arcs = kDensity * n * kLatticeDims.size() * (kDirected ? 2 : 1);
+    e.streams = true;
+    break;
+  case kPlanar:
+    //a triangulation has about 3n edges, its quad-edges take 100 bytes each
+    e.arcs = kDensity * 3 * n * (kDirected ? 2 : 1);
+    e.aux_bytes = n * (32 + 3 * 100);
+    e.buffers_arcs = true;
+    e.extra_seconds = 3.5e-6 * n;
+    break;
+  case kBipartite:
+    e.arcs = kDensity * kBipartiteLeft * (n - kBipartiteLeft);
+    e.aux_bytes = kBipartiteNoIsolated ? n : 0;
+    e.buffers_arcs = true;
+    break;
+  case kHolmeKim:
+    e.arcs = kHolmeKimInitialNodes * (kHolmeKimInitialNodes - 1) / 2.0 + (n - kHolmeKimInitialNodes) * kHolmeKimEdges;
+    //endpoints, neighbour lists and stamps
+    e.aux_bytes = e.arcs * 2 * id_bytes * 2.5 + n * (24 + id_bytes);
+    e.arc_seconds = 3e-7;
+    e.parallel = false;
+    e.grows_lists = true;
+    break;
+  case kForestFire:
+  case kCopying:
+    if (kGenType == kForestFire) {
+      //the ambassador and the first wave of its burning
+      e.arcs = n * (1 + kForestFireForward / (1 - kForestFireForward) * (1 + kForestFireBackward));
+      e.arc_seconds = 3e-7;
+    }
+    else {
+      e.arcs = n * kCopyingDegree;
+    }
+    //the growing graph, out and in links
+    e.aux_bytes = n * (16 + 2 * id_bytes) + e.arcs * (2 * id_bytes + 8);
+    e.parallel = false;
+    break;
+  }
+  //a rank generates only the arcs of its slice
+  e.arcs /= Ranks().num_ranks;
+  return e;
+}
+
+//Reports a scratch file error of an external graph. The graph is dropped first, so its run files are removed
+//even when the process exits.
+template <typename GraphT>
+void CheckGraph(GraphT& graph) {
+  std::string error = graph.error();
+  if (!error.empty()) {
+    graph = GraphT();
+    Errors() << error << std::endl;
+    Fail(2);
+  }
+}
+
+//Reports a write error of the output backend.
+void CheckOutput() {
+  if (!OutputError().empty()) {
+    Errors() << OutputError() << std::endl;
+    Fail(2);
+  }
+}
+
+//Generates the graph with the id and cost types picked on the command line and writes it out.
+template <typename GraphT>
+int Generate() {
+  //range checked against the id type while parsing
+  typename GraphT::Node n = (typename GraphT::Node)kNumNodes;
+  GraphT generated_graph;
+  switch (kGenType) {
+  case kSimpleConnectedRandom:
+    generated_graph = SimpleConnectedRandomGraph<GraphT>(n, kRandomEngine, kDensity, kMinCost, kMaxCost);
+    break;
+  case kRandom:
+    if (kStream) {
+      StreamRandomGraph(OutputFile(), kOutFormat, kNumCenters, kNumNodes, kRandomEngine, kDirected, kDensity, kMinCost, kMaxCost);
+      CheckOutput();
+      Stats().mark_stream();
+      return 0;
+    }
+    generated_graph = RandomGraph<GraphT>(n, kRandomEngine, kDirected, kDensity, kMinCost, kMaxCost);
+    break;
+  case kGrid:
+    generated_graph = Random2DGridGraph<GraphT>(n, kRandomEngine, kDirected, kDensity, kMinCost, kMaxCost);
+    break;
+  case kScaleFree:
+    generated_graph = RandomScaleFreeGraph<GraphT>(n, kRandomEngine, kScaleFreeInitialNodes, kScaleFreeOffsetExponent, kScaleFreeMinDegree, kMinCost, kMaxCost);
+    break;
+  case kChungLu:
+    if (kStream) {
+      StreamChungLuGraph(OutputFile(), kOutFormat, kNumCenters, kChungLuWeights, kRandomEngine, kMinCost, kMaxCost);
+      CheckOutput();
+      Stats().mark_stream();
+      return 0;
+    }
+    generated_graph = ChungLuGraph<GraphT>(kChungLuWeights, kRandomEngine, kMinCost, kMaxCost);
+    break;
+  case kStochasticBlock:
+    generated_graph = StochasticBlockGraph<GraphT>(kBlockSizes, kBlockProbs, kRandomEngine, kDirected, kMinCost, kMaxCost);
+    break;
+  case kSmallWorld:
+    generated_graph = SmallWorldGraph<GraphT>(n, kRandomEngine, kDirected, kSmallWorldNeighbours, kSmallWorldRewire, kMinCost, kMaxCost);
+    break;
+  case kConfiguration:
+  case kRegular:
+    generated_graph = ConfigurationGraph<GraphT>(kDegrees, kRandomEngine, kConfigurationErase, kMinCost, kMaxCost);
+    break;
+  case kHyperbolic:
+    generated_graph = HyperbolicGraph<GraphT>(n, kRandomEngine, kDirected, kHyperbolicAvgDegree, kHyperbolicExponent, kMinCost, kMaxCost);
+    break;
+  case kLattice:
+    //streamed straight to the output, no Graph is built
+    StreamLatticeGraph(OutputFile(), kOutFormat, kNumCenters, kLatticeDims, kRandomEngine, kLatticeTorus, kDirected, kDensity, kMinCost, kMaxCost);
+    CheckOutput();
+    Stats().mark_stream();
+    return 0;
+  case kPlanar:
+    generated_graph = PlanarGraph<GraphT>((int)kNumNodes, kRandomEngine, kDirected, kDensity, kMinCost, kMaxCost);
+    break;
+  case kBipartite:
+    generated_graph = BipartiteGraph<GraphT>(n, (typename GraphT::Node)kBipartiteLeft, kRandomEngine, kDensity, kBipartiteNoIsolated, kMinCost, kMaxCost);
+    break;
+  case kHolmeKim:
+    generated_graph = HolmeKimGraph<GraphT>(n, kRandomEngine, kHolmeKimInitialNodes, kHolmeKimEdges, kHolmeKimTriad, kMinCost, kMaxCost);
+    break;
+  case kForestFire:
+    generated_graph = ForestFireGraph<GraphT>(n, kRandomEngine, kForestFireForward, kForestFireBackward, kMinCost, kMaxCost);
+    break;
+  case kCopying:
+    generated_graph = CopyingGraph<GraphT>(n, kRandomEngine, kCopyingDegree, kCopyingRandom, kMinCost, kMaxCost);
+    break;
+  case kGeometric:
+    generated_graph = RandomGeometricGraph<GraphT>(n, kRandomEngine, kDirected, kGeometricDim, kGeometricRadius, kGeometricEuclideanCost, kMinCost, kMaxCost);
+    break;
+  }
+  if (kSimple) {
+    generated_graph.make_simple();
+  }
+  CheckGraph(generated_graph);
+  Stats().mark("generate");
+
+  switch (kOutFormat) {
+  case kPajek:
+    generated_graph.output_pajek();
+    break;
+  case kPmed:
+    generated_graph.output_pmed(kNumCenters);
+  }
+  CheckGraph(generated_graph);
+  CheckOutput();
+  Stats().mark("output");
+  return 0;
+}
+
+//Picks the in-memory or the external graph for the given id and cost types.
+template <typename Node, typename Weight>
+int GenerateWith() {
+  if (kExternal) {
+    return Generate<ExternalGraph<Node, std::int64_t, Weight>>();
+  }
+  return Generate<Graph<Node, std::int64_t, Weight>>();
+}
+
+//Declares every command line option.
+bool AddOptions(cxxopts::Options& options) {
+  options.add_options()
+    ("help", "Print help")
+    ("d,debug", "Enable debugging")
+    ("n,nodes", "Number of nodes, [int]", cxxopts::value<long long>())
+    ("f,format", "Output format type, [pajek,pmed]", cxxopts::value<std::string>())
+    ("p,density", "Density of edges, [double (0,1] ]", cxxopts::value<double>())
+    ("t,type", "Graph type [random, csrandom, grid, scalefree, geometric, chunglu, sbm, smallworld, configuration, regular, hyperbolic, lattice, planar, bipartite, holmekim, forestfire, copying]", cxxopts::value<std::string>())
+    ("s,seed", "Random generator seed, [int]", cxxopts::value<int>())
+    ("k,centers", "Number of centers for pmed output, [int (1,n-1) ]", cxxopts::value<long long>())
+    ("u,undirected", "Generate undirected graphs")
+    ("mincost", "Minimum cost of edges", cxxopts::value<int>())
+    ("maxcost", "Maximum cost of edges", cxxopts::value<int>())
+    ("ids", "Bits of node ids, 64 for more than 2^31 nodes [32,64]", cxxopts::value<int>())
+    ("weights", "Bits of edge costs, 16 saves memory when costs fit [16,32]", cxxopts::value<int>())
+    ("threads", "Number of threads, by default one per core [int]", cxxopts::value<int>())
+    ("huge_pages", "Page size backing the large arrays of the graph, by default transparent [off,transparent,explicit]", cxxopts::value<std::string>())
+    ("io", "Output backend, uring keeps several large writes to a regular file in flight on Linux, by default stdio [stdio,uring]", cxxopts::value<std::string>())
+    ("simple", "Drop self-loops and parallel arcs from the generated graph, keeping the cheapest arc")
+    ("max-memory", "Memory limit in MB, streaming or external mode is picked when the graph does not fit, for every job of a batch unless it sets its own [int]", cxxopts::value<long long>())
+    ("plan", "Write the predicted strategy, memory, time and output size in place of the graph")
+    ("stats", "Print the wall and CPU time of every phase, edges and bytes per second, the draws of scalefree and csrandom and peak memory to stderr [text,json]", cxxopts::value<std::string>()->implicit_value("text"))
+    ("output", "File to write the graph to instead of stdout, with several ranks .<rank> is appended. In batch mode a pattern, {job} is the job number and {option} its value in the job [path]", cxxopts::value<std::string>())
+    ;
+  options.add_options("batch")
+    ("batch", "File with the options of one graph per line, the graphs are generated in parallel [path]", cxxopts::value<std::string>())
+    ("sweep", "Options of a graph where {a,b,c} lists values and {lo..hi} counts through them, one job per combination [options]", cxxopts::value<std::string>())
+    ("benchmark", "Time every generator and output format, or the jobs of --batch or --sweep, and write the results as JSON to stdout or --output")
+    ("benchmark_baseline", "JSON results of an earlier --benchmark to compare with, the ratios go to stderr [path]", cxxopts::value<std::string>())
+    ("serve", "Run as a daemon answering requests of one line of graph options each on this Unix socket [path]", cxxopts::value<std::string>())
+    ;
+  options.add_options("ranks")
+    ("num-ranks", "Number of processes sharing the generation, each writes the edges of its slice of the sources [int]", cxxopts::value<long long>())
+    ("rank", "Slice generated by this process [int [0,num-ranks-1] ]", cxxopts::value<long long>())
+    ;
+  options.add_options("external")
+    ("external", "Spill the edges to disk in sorted runs and merge them into the output, for graphs larger than memory")
+    ("external_dir", "Scratch directory for the runs, by default the working directory [path]", cxxopts::value<std::string>())
+    ("external_memory", "Memory for the edge buffers in MB, by default 1024 [int]", cxxopts::value<long long>())
+    ;
+  options.add_options("scalefree")
+    ("scalefree_initial_nodes", "Number of inital nodes in graph [int]", cxxopts::value<int>())
+    ("scalefree_min_degree", "Minimum degree of new nodes [int]", cxxopts::value<int>())
+    ("scalefree_offset_exponent", "Offset exponent applied to the probability of new edges [double]", cxxopts::value<double>())
+    ;
+  options.add_options("geometric")
+    ("geometric_dim", "Dimension of the unit cube the points are placed in, [2,3]", cxxopts::value<int>())
+    ("geometric_radius", "Connection radius, by default derived from density [double (0,1] ]", cxxopts::value<double>())
+    ("geometric_euclidean_cost", "Scale edge costs from mincost to maxcost by distance instead of drawing them")
+    ;
+  options.add_options("chunglu")
+    ("chunglu_exponent", "Power law exponent of the expected degrees [double >1]", cxxopts::value<double>())
+    ("chunglu_avg_degree", "Average expected degree, by default density*(n-1) [double]", cxxopts::value<double>())
+    ("chunglu_weights", "File with one expected degree per node, replaces the power law [path]", cxxopts::value<std::string>())
+    ;
+  options.add_options("sbm")
+    ("sbm_sizes", "Comma separated block sizes summing to n [int,int,...]", cxxopts::value<std::string>())
+    ("sbm_probs", "Block to block edge probabilities, rows separated by ';' [double,...;double,...]", cxxopts::value<std::string>())
+    ("sbm_file", "File with the block sizes on the first line and one probability row per line after it [path]", cxxopts::value<std::string>())
+    ;
+  options.add_options("smallworld")
+    ("smallworld_neighbours", "Ring neighbours on each side, by default density*(n-1)/2 [int]", cxxopts::value<int>())
+    ("smallworld_rewire", "Probability of rewiring each ring edge [double [0,1] ]", cxxopts::value<double>())
+    ;
+  options.add_options("configuration")
+    ("configuration_degrees", "File with one degree per node [path]", cxxopts::value<std::string>())
+    ("regular_degree", "Degree of every node of a regular graph, by default density*(n-1) [int]", cxxopts::value<int>())
+    ("configuration_erase", "Drop self-loops and multi-edges after pairing")
+    ;
+  options.add_options("hyperbolic")
+    ("hyperbolic_avg_degree", "Average degree, by default density*(n-1) [double]", cxxopts::value<double>())
+    ("hyperbolic_exponent", "Power law exponent of the degrees [double >2]", cxxopts::value<double>())
+    ;
+  options.add_options("lattice")
+    ("lattice_dims", "Comma separated sizes of the dimensions, their product must be n, by default a cube [int,int,...]", cxxopts::value<std::string>())
+    ("lattice_torus", "Wrap every dimension around")
+    ;
+  options.add_options("bipartite")
+    ("bipartite_left", "Number of nodes on the left side, the rest are on the right, by default n/2 [int [1,n-1] ]", cxxopts::value<long long>())
+    ("bipartite_no_isolated", "Give every node without an edge one to a random node of the other side")
+    ;
+  options.add_options("holmekim")
+    ("holmekim_initial_nodes", "Number of inital nodes in graph [int]", cxxopts::value<int>())
+    ("holmekim_edges", "Number of edges added with every new node [int [1,holmekim_initial_nodes] ]", cxxopts::value<int>())
+    ("holmekim_triad", "Probability that an edge closes a triangle instead of attaching preferentially [double [0,1] ]", cxxopts::value<double>())
+    ;
+  options.add_options("forestfire")
+    ("forestfire_forward", "Forward burning probability [double [0,1) ]", cxxopts::value<double>())
+    ("forestfire_backward", "Backward burning ratio, the backward probability is forward*ratio [double [0,1] ]", cxxopts::value<double>())
+    ;
+  options.add_options("copying")
+    ("copying_degree", "Out-links of every new node [int >= 1]", cxxopts::value<int>())
+    ("copying_random", "Probability that a link goes to a random node instead of being copied [double [0,1] ]", cxxopts::value<double>())
+    ;
+  return true;
+}
+
+//Options of the command line, built once. Batch jobs, daemon requests and the {name} of output patterns only
+//parse with it, so a short and a long name of an option are always the same option.
+cxxopts::Options& GraphOptions() {
+  static cxxopts::Options options("GraphGen", "Random Graph Generator");
+  static bool added = AddOptions(options);
+  (void)added;
+  return options;
+}
+
+//Parses a command line, or the options of one batch job or daemon request, into the settings above.
+void ParseOptions(int argc, const char* argv[], bool job) {
+  ResetSettings();
+  Stats().restart();
   try {
-    cxxopts::Options options("GraphGen", "Random Graph Generator");
-    options.add_options()
-      ("help", "Print help")
-      ("d,debug", "Enable debugging")
-      ("n,nodes", "Number of nodes, [int]", cxxopts::value<int>())
-      ("f,format", "Output format type, [pajek,pmed]", cxxopts::value<std::string>())
-      ("p,density", "Density of edges, [double (0,1] ]", cxxopts::value<double>())
-      ("t,type", "Graph type [random,csrandom,grid,scalefree]", cxxopts::value<std::string>())
-      ("s,seed", "Random generator seed, [int]", cxxopts::value<int>())
-      ("k,centers", "Number of centers for pmed output, [int (1,n-1) ]", cxxopts::value<int>())
-      ("u,undirected", "Generate undirected graphs")
-      ("mincost", "Minimum cost of edges", cxxopts::value<int>())
-      ("maxcost", "Maximum cost of edges", cxxopts::value<int>())
-      ;
-    options.add_options("scalefree")
-      ("scalefree_initial_nodes", "Number of inital nodes in graph [int]", cxxopts::value<int>())
-      ("scalefree_min_degree", "Minimum degree of new nodes [int]", cxxopts::value<int>())
-      ("scalefree_offset_exponent", "Offset exponent applied to the probability of new edges [double]", cxxopts::value<double>())
-      ;
+    cxxopts::Options& options = GraphOptions();
     auto result = options.parse(argc, argv);
 
+    //process wide settings are taken from the command line, not from the jobs
+    if (job) {
+      for (const char* name : { "help", "threads", "huge_pages", "io", "num-ranks", "rank", "output", "batch", "sweep", "serve", "benchmark", "benchmark_baseline" }) {
+        if (result.count(name)) {
+          Errors() << "Option " << name << " cannot be set in a batch job or request" << std::endl;
+          Fail(2);
+        }
+      }
+    }
+
     //Print help
     if (result.count("help")) {
-      std::cout << options.help({ "","scalefree" }) << std::endl;
+      std::cout << options.help({ "","external","ranks","batch","scalefree","geometric","chunglu","sbm","smallworld","configuration","hyperbolic","lattice","bipartite","holmekim","forestfire","copying" }) << std::endl;
       exit(0);
     }
     if (result.count("debug")) {
       kDebug = true;
       std::cerr << "debuging enabled" << std::endl;
     }
+    if (result.count("stats")) {
+      std::string format = result["stats"].as<std::string>();
+      if (format != "text" && format != "json") {
+        Errors() << "Stats must be text or json, input=" << format << std::endl;
+        Fail(2);
+      }
+      Stats().enabled = true;
+      Stats().json = format == "json";
+    }
+    //before anything runs in parallel, the thread pool is started by the first loop
+    if (result.count("threads")) {
+      int threads = result["threads"].as<int>();
+      if (threads < 1) {
+        Errors() << "Number of threads must be at least 1, input=" << threads << std::endl;
+        Fail(2);
+      }
+      ThreadSetting() = threads;
+    }
+    if (result.count("huge_pages")) {
+      std::string mode = result["huge_pages"].as<std::string>();
+      if (kHugePagesTypeMap.count(mode) == 0) {
+        Errors() << "Huge pages must be off, transparent or explicit, input=" << mode << std::endl;
+        Fail(2);
+      }
+      HugePageMode() = kHugePagesTypeMap[mode];
+    }
+    if (result.count("io")) {
+      std::string backend = result["io"].as<std::string>();
+      if (kOutputBackendTypeMap.count(backend) == 0) {
+        Errors() << "Output backend must be stdio or uring, input=" << backend << std::endl;
+        Fail(2);
+      }
+      OutputBackendMode() = kOutputBackendTypeMap[backend];
+    }
+    //like --external, a job may set its own, the command line sets those of every job
+    if (result.count("external_dir")) {
+      Spill().directory = result["external_dir"].as<std::string>();
+    }
+    if (result.count("external_memory")) {
+      long long megabytes = result["external_memory"].as<long long>();
+      if (megabytes < 1) {
+        Errors() << "External memory must be at least 1 MB, input=" << megabytes << std::endl;
+        Fail(2);
+      }
+      Spill().memory_bytes = (size_t)megabytes << 20;
+    }
+    if (!job) {
+      SpillDefaults() = Spill();
+    }
+    //the same for the plan, which is made once the job's generator is known
+    if (job) {
+      kMaxMemory = kDefaultMaxMemory;
+      kPlan = kDefaultPlan;
+    }
+    if (result.count("max-memory")) {
+      long long megabytes = result["max-memory"].as<long long>();
+      if (megabytes < 1) {
+        Errors() << "Max memory must be at least 1 MB, input=" << megabytes << std::endl;
+        Fail(2);
+      }
+      kMaxMemory = megabytes * kMegabyte;
+    }
+    if (result.count("plan")) {
+      kPlan = true;
+    }
+    if (!job) {
+      kDefaultMaxMemory = kMaxMemory;
+      kDefaultPlan = kPlan;
+    }
+    if (kDebug) {
+      std::cerr << "threads: " << NumThreads() << std::endl;
+      std::cerr << "huge_pages: " << HugePageMode() << std::endl;
+      std::cerr << "io: " << OutputBackendMode() << std::endl;
+    }
+
+    // Daemon paramaters
+    if (result.count("serve")) {
+#ifdef __linux__
+      kServePath = result["serve"].as<std::string>();
+      if (kDebug) {
+        std::cerr << "serve: " << kServePath << std::endl;
+      }
+      return;
+#else
+      Errors() << "Daemon mode needs Unix domain sockets" << std::endl;
+      Fail(2);
+#endif
+    }
+
+    // Batch paramaters
+    if (result.count("batch") || result.count("sweep") || result.count("benchmark")) {
+      if (result.count("output")) {
+        kOutputPattern = result["output"].as<std::string>();
+      }
+      else if (!result.count("benchmark")) {
+        Errors() << "Batch mode needs an output file pattern" << std::endl;
+        Fail(2);
+      }
+      if (result.count("batch")) {
+        std::string path = result["batch"].as<std::string>();
+        std::ifstream in(path);
+        if (!in) {
+          Errors() << "Cannot open batch file: " << path << std::endl;
+          Fail(2);
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+          if (line.empty() || line[0] == '#') {
+            continue;
+          }
+          AddJobs(line);
+        }
+      }
+      if (result.count("sweep")) {
+        AddJobs(result["sweep"].as<std::string>());
+      }
+      if (result.count("benchmark")) {
+#ifdef __linux__
+        kBenchmark = true;
+        if (result.count("benchmark_baseline")) {
+          kBenchmarkBaseline = result["benchmark_baseline"].as<std::string>();
+        }
+        if (kBatchJobs.empty()) {
+          for (const char* line : kBenchmarkSuite) {
+            AddJobs(line);
+          }
+        }
+#else
+        Errors() << "Benchmark mode needs Linux" << std::endl;
+        Fail(2);
+#endif
+      }
+      if (kBatchJobs.empty()) {
+        Errors() << "Batch has no jobs" << std::endl;
+        Fail(2);
+      }
+      if (kDebug) {
+        std::cerr << "jobs: " << kBatchJobs.size() << std::endl;
+        std::cerr << "output: " << kOutputPattern << std::endl;
+      }
+      return;
+    }
 
     //Number of nodes
     if (result.count("nodes")) {
-      kNumNodes = result["nodes"].as<int>();
+      kNumNodes = result["nodes"].as<long long>();
       if (kNumNodes <= 0) {
-        std::cerr << "Invalid number of nodes: " << kNumNodes << std::endl;
-        exit(2);
+        Errors() << "Invalid number of nodes: " << kNumNodes << std::endl;
+        Fail(2);
       }
       if (kDebug) {
         std::cerr << "Nodes: " << kNumNodes << std::endl;
       }
     }
     else {
-      std::cerr << "Number of nodes not defined!" << std::endl;
-      exit(2);
+      Errors() << "Number of nodes not defined!" << std::endl;
+      Fail(2);
     }
 
     //Output format
@@ -101,29 +815,29 @@ int main(int argc, const char* argv[]) {
         }
       }
       else {
-        std::cerr << "Unknown format type:" << format << std::endl;
-        exit(2);
+        Errors() << "Unknown format type:" << format << std::endl;
+        Fail(2);
       }
     }
     else {
-      std::cerr << "Output format type not defined!" << std::endl;
-      exit(2);
+      Errors() << "Output format type not defined!" << std::endl;
+      Fail(2);
     }
 
     //Denstiy
     if (result.count("density")) {
       kDensity = result["density"].as<double>();
       if (kDensity <= 0 || kDensity > 1) {
-        std::cerr << "Density must be a value in range (0,1], input=" << kDensity << std::endl;
-        exit(2);
+        Errors() << "Density must be a value in range (0,1], input=" << kDensity << std::endl;
+        Fail(2);
       }
       if (kDebug) {
         std::cerr << "Density: " << kDensity << std::endl;
       }
     }
     else {
-      std::cerr << "Density not defined!" << std::endl;
-      exit(2);
+      Errors() << "Density not defined!" << std::endl;
+      Fail(2);
     }
 
 
@@ -137,13 +851,13 @@ int main(int argc, const char* argv[]) {
         }
       }
       else {
-        std::cerr << "Unknown generator type:" << type << std::endl;
-        exit(2);
+        Errors() << "Unknown generator type:" << type << std::endl;
+        Fail(2);
       }
     }
     else {
-      std::cerr << "Generator type not defined!" << std::endl;
-      exit(2);
+      Errors() << "Generator type not defined!" << std::endl;
+      Fail(2);
     }
 
     //Seed 
@@ -165,10 +879,10 @@ int main(int argc, const char* argv[]) {
 
     //Number of centers
     if (result.count("centers")) {
-      kNumCenters = result["centers"].as<int>();
+      kNumCenters = result["centers"].as<long long>();
       if (kNumCenters < 1 || kNumCenters >= kNumNodes) {
-        std::cerr << "centers must be a value in range (1,nodes-1) input=" << kNumCenters << std::endl;
-        exit(2);
+        Errors() << "centers must be a value in range (1,nodes-1) input=" << kNumCenters << std::endl;
+        Fail(2);
       }
     }
     else {
@@ -204,21 +918,62 @@ int main(int argc, const char* argv[]) {
       std::cerr << "maxcost: " << kMaxCost << std::endl;
     }
 
+    //Width of ids and costs
+    if (result.count("ids")) {
+      kIdBits = result["ids"].as<int>();
+      if (kIdBits != 32 && kIdBits != 64) {
+        Errors() << "Id bits must be 32 or 64, input=" << kIdBits << std::endl;
+        Fail(2);
+      }
+    }
+    if (kIdBits == 32 && kNumNodes > INT32_MAX) {
+      Errors() << "More than 2^31-1 nodes need 64 bit ids, set ids to 64" << std::endl;
+      Fail(2);
+    }
+    if (result.count("weights")) {
+      kWeightBits = result["weights"].as<int>();
+      if (kWeightBits != 16 && kWeightBits != 32) {
+        Errors() << "Weight bits must be 16 or 32, input=" << kWeightBits << std::endl;
+        Fail(2);
+      }
+    }
+    if (kWeightBits == 16 && (kMinCost < INT16_MIN || kMaxCost > INT16_MAX)) {
+      Errors() << "Costs must be in range [" << INT16_MIN << "," << INT16_MAX << "] for 16 bit weights" << std::endl;
+      Fail(2);
+    }
+    if (result.count("simple")) {
+      kSimple = true;
+    }
+    if (kDebug) {
+      std::cerr << "simple: " << kSimple << std::endl;
+      std::cerr << "ids: " << kIdBits << std::endl;
+      std::cerr << "weights: " << kWeightBits << std::endl;
+    }
+
+    // External paramaters
+    if (result.count("external")) {
+      kExternal = true;
+      if (kDebug) {
+        std::cerr << "external_dir: " << Spill().directory << std::endl;
+        std::cerr << "external_memory: " << (Spill().memory_bytes >> 20) << std::endl;
+      }
+    }
+
 
     // ScaleFree paramaters
     if (kGenType == kScaleFree) {
       if (result.count("scalefree_initial_nodes")) {
         kScaleFreeInitialNodes = result["scalefree_initial_nodes"].as<int>();
         if (kScaleFreeInitialNodes >= kNumNodes || kScaleFreeInitialNodes < 1) {
-          std::cerr << "Number of initial nodes must be in range [1,n), input=" << kScaleFreeInitialNodes << std::endl;
-          exit(2);
+          Errors() << "Number of initial nodes must be in range [1,n), input=" << kScaleFreeInitialNodes << std::endl;
+          Fail(2);
         }
       }
       if (result.count("scalefree_min_degree")) {
         kScaleFreeMinDegree = result["scalefree_min_degree"].as<int>();
         if (kScaleFreeMinDegree > kScaleFreeInitialNodes || kScaleFreeMinDegree < 1) {
-          std::cerr << "Minimum degree must be in range [1,scalefree_initial_nodes], input=" << kScaleFreeMinDegree << std::endl;
-          exit(2);
+          Errors() << "Minimum degree must be in range [1,scalefree_initial_nodes], input=" << kScaleFreeMinDegree << std::endl;
+          Fail(2);
         }
       }
       if (result.count("scalefree_offset_exponent")) {
@@ -231,33 +986,638 @@ int main(int argc, const char* argv[]) {
       }
     }
 
+    // Geometric paramaters
+    if (kGenType == kGeometric) {
+      if (result.count("geometric_dim")) {
+        kGeometricDim = result["geometric_dim"].as<int>();
+        if (kGeometricDim != 2 && kGeometricDim != 3) {
+          Errors() << "Geometric dimension must be 2 or 3, input=" << kGeometricDim << std::endl;
+          Fail(2);
+        }
+      }
+      //expected fraction of connected pairs is the volume of the ball, ignoring the border
+      if (kGeometricDim == 2) {
+        kGeometricRadius = std::sqrt(kDensity / kPi);
+      }
+      else {
+        kGeometricRadius = std::cbrt(3 * kDensity / (4 * kPi));
+      }
+      if (result.count("geometric_radius")) {
+        kGeometricRadius = result["geometric_radius"].as<double>();
+        if (kGeometricRadius <= 0 || kGeometricRadius > 1) {
+          Errors() << "Geometric radius must be a value in range (0,1], input=" << kGeometricRadius << std::endl;
+          Fail(2);
+        }
+      }
+      if (result.count("geometric_euclidean_cost")) {
+        kGeometricEuclideanCost = true;
+      }
+      if (kDebug) {
+        std::cerr << "geometric_dim: " << kGeometricDim << std::endl;
+        std::cerr << "geometric_radius: " << kGeometricRadius << std::endl;
+        std::cerr << "geometric_euclidean_cost: " << kGeometricEuclideanCost << std::endl;
+      }
+    }
+
+    // ChungLu paramaters
+    if (kGenType == kChungLu) {
+      if (result.count("chunglu_weights")) {
+        std::string path = result["chunglu_weights"].as<std::string>();
+        std::ifstream in(path);
+        if (!in) {
+          Errors() << "Cannot open weight file: " << path << std::endl;
+          Fail(2);
+        }
+        double w;
+        while (in >> w) {
+          if (w < 0) {
+            Errors() << "Weights must not be negative, input=" << w << std::endl;
+            Fail(2);
+          }
+          kChungLuWeights.push_back(w);
+        }
+        if ((long long)kChungLuWeights.size() != kNumNodes) {
+          Errors() << "Weight file has " << kChungLuWeights.size() << " weights, expected " << kNumNodes << std::endl;
+          Fail(2);
+        }
+      }
+      else {
+        if (result.count("chunglu_exponent")) {
+          kChungLuExponent = result["chunglu_exponent"].as<double>();
+          if (kChungLuExponent <= 1) {
+            Errors() << "Exponent must be greater than 1, input=" << kChungLuExponent << std::endl;
+            Fail(2);
+          }
+        }
+        kChungLuAvgDegree = kDensity * (kNumNodes - 1);
+        if (result.count("chunglu_avg_degree")) {
+          kChungLuAvgDegree = result["chunglu_avg_degree"].as<double>();
+          if (kChungLuAvgDegree <= 0 || kChungLuAvgDegree > kNumNodes - 1) {
+            Errors() << "Average degree must be in range (0,n-1], input=" << kChungLuAvgDegree << std::endl;
+            Fail(2);
+          }
+        }
+        kChungLuWeights = PowerLawWeights(kNumNodes, kChungLuExponent, kChungLuAvgDegree);
+        if (kDebug) {
+          std::cerr << "chunglu_exponent: " << kChungLuExponent << std::endl;
+          std::cerr << "chunglu_avg_degree: " << kChungLuAvgDegree << std::endl;
+        }
+      }
+    }
+
+    // Stochastic block model paramaters
+    if (kGenType == kStochasticBlock) {
+      if (result.count("sbm_file")) {
+        std::string path = result["sbm_file"].as<std::string>();
+        std::ifstream in(path);
+        if (!in) {
+          Errors() << "Cannot open block model file: " << path << std::endl;
+          Fail(2);
+        }
+        std::string line;
+        std::getline(in, line);
+        kBlockSizes = ParseList<long long>(line, ' ');
+        while (std::getline(in, line)) {
+          if (!line.empty()) {
+            kBlockProbs.push_back(ParseList<double>(line, ' '));
+          }
+        }
+      }
+      else if (result.count("sbm_sizes") && result.count("sbm_probs")) {
+        kBlockSizes = ParseList<long long>(result["sbm_sizes"].as<std::string>(), ',');
+        for (auto& row : ParseList<std::string>(result["sbm_probs"].as<std::string>(), ';')) {
+          kBlockProbs.push_back(ParseList<double>(row, ','));
+        }
+      }
+      else {
+        Errors() << "Block model needs sbm_sizes and sbm_probs or sbm_file!" << std::endl;
+        Fail(2);
+      }
+      long long total = 0;
+      for (long long size : kBlockSizes) {
+        if (size <= 0) {
+          Errors() << "Block sizes must be positive, input=" << size << std::endl;
+          Fail(2);
+        }
+        total += size;
+      }
+      if (total != kNumNodes) {
+        Errors() << "Block sizes sum to " << total << ", expected " << kNumNodes << std::endl;
+        Fail(2);
+      }
+      if (kBlockProbs.size() != kBlockSizes.size()) {
+        Errors() << "Probability matrix has " << kBlockProbs.size() << " rows, expected " << kBlockSizes.size() << std::endl;
+        Fail(2);
+      }
+      for (auto& row : kBlockProbs) {
+        if (row.size() != kBlockSizes.size()) {
+          Errors() << "Probability matrix row has " << row.size() << " values, expected " << kBlockSizes.size() << std::endl;
+          Fail(2);
+        }
+        for (double p : row) {
+          if (p < 0 || p > 1) {
+            Errors() << "Block probabilities must be in range [0,1], input=" << p << std::endl;
+            Fail(2);
+          }
+        }
+      }
+      if (kDebug) {
+        std::cerr << "sbm blocks: " << kBlockSizes.size() << std::endl;
+      }
+    }
+
+    // Small world paramaters
+    if (kGenType == kSmallWorld) {
+      kSmallWorldNeighbours = std::max(1, (int)std::lround(kDensity * (kNumNodes - 1) / 2));
+      if (result.count("smallworld_neighbours")) {
+        kSmallWorldNeighbours = result["smallworld_neighbours"].as<int>();
+      }
+      if (kSmallWorldNeighbours < 1 || 3 * kSmallWorldNeighbours + 1 >= kNumNodes) {
+        Errors() << "Ring neighbours must be in range [1,(n-2)/3], input=" << kSmallWorldNeighbours << std::endl;
+        Fail(2);
+      }
+      if (result.count("smallworld_rewire")) {
+        kSmallWorldRewire = result["smallworld_rewire"].as<double>();
+        if (kSmallWorldRewire < 0 || kSmallWorldRewire > 1) {
+          Errors() << "Rewire probability must be in range [0,1], input=" << kSmallWorldRewire << std::endl;
+          Fail(2);
+        }
+      }
+      if (kDebug) {
+        std::cerr << "smallworld_neighbours: " << kSmallWorldNeighbours << std::endl;
+        std::cerr << "smallworld_rewire: " << kSmallWorldRewire << std::endl;
+      }
+    }
+
+    // Configuration model paramaters
+    if (kGenType == kConfiguration) {
+      if (!result.count("configuration_degrees")) {
+        Errors() << "Degree file not defined!" << std::endl;
+        Fail(2);
+      }
+      std::string path = result["configuration_degrees"].as<std::string>();
+      std::ifstream in(path);
+      if (!in) {
+        Errors() << "Cannot open degree file: " << path << std::endl;
+        Fail(2);
+      }
+      int degree;
+      while (in >> degree) {
+        if (degree < 0) {
+          Errors() << "Degrees must not be negative, input=" << degree << std::endl;
+          Fail(2);
+        }
+        kDegrees.push_back(degree);
+      }
+      if ((long long)kDegrees.size() != kNumNodes) {
+        Errors() << "Degree file has " << kDegrees.size() << " degrees, expected " << kNumNodes << std::endl;
+        Fail(2);
+      }
+    }
+    if (kGenType == kRegular) {
+      int degree = (int)std::lround(kDensity * (kNumNodes - 1));
+      if (result.count("regular_degree")) {
+        degree = result["regular_degree"].as<int>();
+      }
+      if (degree < 0 || degree >= kNumNodes) {
+        Errors() << "Regular degree must be in range [0,n-1], input=" << degree << std::endl;
+        Fail(2);
+      }
+      kDegrees.assign(kNumNodes, degree);
+      if (kDebug) {
+        std::cerr << "regular_degree: " << degree << std::endl;
+      }
+    }
+    if (kGenType == kConfiguration || kGenType == kRegular) {
+      long long stubs = 0;
+      for (int degree : kDegrees) {
+        stubs += degree;
+      }
+      if (stubs % 2 != 0) {
+        Errors() << "Sum of degrees must be even, input=" << stubs << std::endl;
+        Fail(2);
+      }
+      if (result.count("configuration_erase")) {
+        kConfigurationErase = true;
+      }
+      if (kDebug) {
+        std::cerr << "configuration_erase: " << kConfigurationErase << std::endl;
+      }
+    }
+
+    // Hyperbolic paramaters
+    if (kGenType == kHyperbolic) {
+      kHyperbolicAvgDegree = kDensity * (kNumNodes - 1);
+      if (result.count("hyperbolic_avg_degree")) {
+        kHyperbolicAvgDegree = result["hyperbolic_avg_degree"].as<double>();
+      }
+      if (kHyperbolicAvgDegree <= 0 || kHyperbolicAvgDegree > kNumNodes - 1) {
+        Errors() << "Average degree must be in range (0,n-1], input=" << kHyperbolicAvgDegree << std::endl;
+        Fail(2);
+      }
+      if (result.count("hyperbolic_exponent")) {
+        kHyperbolicExponent = result["hyperbolic_exponent"].as<double>();
+        if (kHyperbolicExponent <= 2) {
+          Errors() << "Exponent must be greater than 2, input=" << kHyperbolicExponent << std::endl;
+          Fail(2);
+        }
+      }
+      if (kDebug) {
+        std::cerr << "hyperbolic_avg_degree: " << kHyperbolicAvgDegree << std::endl;
+        std::cerr << "hyperbolic_exponent: " << kHyperbolicExponent << std::endl;
+      }
+    }
+
+    // Lattice paramaters
+    if (kGenType == kLattice) {
+      if (result.count("lattice_dims")) {
+        kLatticeDims = ParseList<long long>(result["lattice_dims"].as<std::string>(), ',');
+      }
+      else {
+        long long side = std::lround(std::cbrt(kNumNodes));
+        kLatticeDims.assign(3, side);
+      }
+      if (kLatticeDims.empty() || (int)kLatticeDims.size() > kMaxLatticeDims) {
+        Errors() << "Lattice needs between 1 and " << kMaxLatticeDims << " dimensions, input=" << kLatticeDims.size() << std::endl;
+        Fail(2);
+      }
+      long long total = 1;
+      for (long long size : kLatticeDims) {
+        if (size <= 0) {
+          Errors() << "Lattice dimensions must be positive, input=" << size << std::endl;
+          Fail(2);
+        }
+        total *= size;
+      }
+      if (total != kNumNodes) {
+        Errors() << "Lattice has " << total << " nodes, expected " << kNumNodes << ", set lattice_dims" << std::endl;
+        Fail(2);
+      }
+      if (result.count("lattice_torus")) {
+        kLatticeTorus = true;
+      }
+      if (kDebug) {
+        std::cerr << "lattice_dims: " << kLatticeDims.size() << std::endl;
+        std::cerr << "lattice_torus: " << kLatticeTorus << std::endl;
+      }
+    }
+
+    // Planar paramaters
+    if (kGenType == kPlanar && kNumNodes > INT32_MAX) {
+      Errors() << "Planar graphs are limited to 2^31-1 nodes, input=" << kNumNodes << std::endl;
+      Fail(2);
+    }
+
+    // Bipartite paramaters
+    if (kGenType == kBipartite) {
+      kBipartiteLeft = kNumNodes / 2;
+      if (result.count("bipartite_left")) {
+        kBipartiteLeft = result["bipartite_left"].as<long long>();
+      }
+      if (kBipartiteLeft < 1 || kBipartiteLeft >= kNumNodes) {
+        Errors() << "Left side must be in range [1,n-1], input=" << kBipartiteLeft << std::endl;
+        Fail(2);
+      }
+      if (result.count("bipartite_no_isolated")) {
+        kBipartiteNoIsolated = true;
+      }
+      if (kDebug) {
+        std::cerr << "bipartite_left: " << kBipartiteLeft << std::endl;
+        std::cerr << "bipartite_no_isolated: " << kBipartiteNoIsolated << std::endl;
+      }
+    }
+
+    // HolmeKim paramaters
+    if (kGenType == kHolmeKim) {
+      if (result.count("holmekim_initial_nodes")) {
+        kHolmeKimInitialNodes = result["holmekim_initial_nodes"].as<int>();
+      }
+      if (kHolmeKimInitialNodes >= kNumNodes || kHolmeKimInitialNodes < 1) {
+        Errors() << "Number of initial nodes must be in range [1,n), input=" << kHolmeKimInitialNodes << std::endl;
+        Fail(2);
+      }
+      if (result.count("holmekim_edges")) {
+        kHolmeKimEdges = result["holmekim_edges"].as<int>();
+      }
+      if (kHolmeKimEdges > kHolmeKimInitialNodes || kHolmeKimEdges < 1) {
+        Errors() << "Edges per node must be in range [1,holmekim_initial_nodes], input=" << kHolmeKimEdges << std::endl;
+        Fail(2);
+      }
+      if (result.count("holmekim_triad")) {
+        kHolmeKimTriad = result["holmekim_triad"].as<double>();
+        if (kHolmeKimTriad < 0 || kHolmeKimTriad > 1) {
+          Errors() << "Triad probability must be in range [0,1], input=" << kHolmeKimTriad << std::endl;
+          Fail(2);
+        }
+      }
+      if (kDebug) {
+        std::cerr << "holmekim_initial_nodes: " << kHolmeKimInitialNodes << std::endl;
+        std::cerr << "holmekim_edges: " << kHolmeKimEdges << std::endl;
+        std::cerr << "holmekim_triad: " << kHolmeKimTriad << std::endl;
+      }
+    }
+
+    // ForestFire paramaters
+    if (kGenType == kForestFire) {
+      if (result.count("forestfire_forward")) {
+        kForestFireForward = result["forestfire_forward"].as<double>();
+        if (kForestFireForward < 0 || kForestFireForward >= 1) {
+          Errors() << "Forward burning probability must be in range [0,1), input=" << kForestFireForward << std::endl;
+          Fail(2);
+        }
+      }
+      if (result.count("forestfire_backward")) {
+        kForestFireBackward = result["forestfire_backward"].as<double>();
+        if (kForestFireBackward < 0 || kForestFireBackward > 1) {
+          Errors() << "Backward burning ratio must be in range [0,1], input=" << kForestFireBackward << std::endl;
+          Fail(2);
+        }
+      }
+      if (kDebug) {
+        std::cerr << "forestfire_forward: " << kForestFireForward << std::endl;
+        std::cerr << "forestfire_backward: " << kForestFireBackward << std::endl;
+      }
+    }
+
+    // Copying paramaters
+    if (kGenType == kCopying) {
+      if (result.count("copying_degree")) {
+        kCopyingDegree = result["copying_degree"].as<int>();
+        if (kCopyingDegree < 1) {
+          Errors() << "Copying degree must be at least 1, input=" << kCopyingDegree << std::endl;
+          Fail(2);
+        }
+      }
+      if (result.count("copying_random")) {
+        kCopyingRandom = result["copying_random"].as<double>();
+        if (kCopyingRandom < 0 || kCopyingRandom > 1) {
+          Errors() << "Random link probability must be in range [0,1], input=" << kCopyingRandom << std::endl;
+          Fail(2);
+        }
+      }
+      if (kDebug) {
+        std::cerr << "copying_degree: " << kCopyingDegree << std::endl;
+        std::cerr << "copying_random: " << kCopyingRandom << std::endl;
+      }
+    }
+
+    // Rank paramaters
+    if (result.count("num-ranks")) {
+      Ranks().num_ranks = result["num-ranks"].as<long long>();
+      if (Ranks().num_ranks < 1) {
+        Errors() << "Number of ranks must be at least 1, input=" << Ranks().num_ranks << std::endl;
+        Fail(2);
+      }
+    }
+    if (result.count("rank")) {
+      Ranks().rank = result["rank"].as<long long>();
+      if (Ranks().rank < 0 || Ranks().rank >= Ranks().num_ranks) {
+        Errors() << "Rank must be in range [0,num-ranks-1], input=" << Ranks().rank << std::endl;
+        Fail(2);
+      }
+    }
+    if (Ranks().num_ranks > 1) {
+      //generators that draw the edges of every block of sources from a stream of its own
+      if (kSlicedTypes.count(kGenType) == 0) {
+        Errors() << "Generator type cannot be split over ranks" << std::endl;
+        Fail(2);
+      }
+      if (kGenType == kBipartite && kBipartiteNoIsolated) {
+        Errors() << "Bipartite graphs without isolated nodes cannot be split over ranks" << std::endl;
+        Fail(2);
+      }
+    }
+    if (result.count("output")) {
+      std::string path = result["output"].as<std::string>();
+      if (Ranks().num_ranks > 1) {
+        path += "." + std::to_string(Ranks().rank);
+      }
+      if (std::freopen(path.c_str(), "wb", stdout) == nullptr) {
+        Errors() << "Cannot open output file: " << path << std::endl;
+        Fail(2);
+      }
+    }
+    if (kDebug) {
+      std::cerr << "rank: " << Ranks().rank << std::endl;
+      std::cerr << "num-ranks: " << Ranks().num_ranks << std::endl;
+    }
+
+    // Plan paramaters
+    if (kMaxMemory > 0 || kPlan) {
+      Estimate estimate = EstimateRun();
+      double spill_memory = result.count("external_memory") ? (double)Spill().memory_bytes : 0;
+      Plan plan = MakePlan(estimate, kMaxMemory, kExternal, spill_memory, kIdBits / 8, kWeightBits / 8, AverageDigits(std::max(std::abs(kMinCost), std::abs(kMaxCost))));
+      if (kPlan) {
+        std::ostringstream text;
+        PrintPlan(text, estimate, plan);
+        kPlanText = text.str();
+        return;
+      }
+      if (!plan.fits) {
+        Errors() << "Needs about " << (long long)(plan.memory_bytes / kMegabyte) << " MB even with external mode, max-memory is " << (long long)(kMaxMemory / kMegabyte) << " MB" << std::endl;
+        Fail(2);
+      }
+      if (plan.strategy == kSpilled) {
+        kExternal = true;
+        Spill().memory_bytes = (size_t)plan.spill_bytes;
+      }
+      kStream = plan.strategy == kStreaming;
+      if (kDebug) {
+        std::cerr << "max-memory: " << (long long)(kMaxMemory / kMegabyte) << std::endl;
+        std::cerr << "external: " << kExternal << std::endl;
+        std::cerr << "stream: " << kStream << std::endl;
+      }
+    }
+    if (kExternal && kGenType == kSimpleConnectedRandom) {
+      Errors() << "csrandom keeps its edge set in memory and cannot run in external mode" << std::endl;
+      Fail(2);
+    }
+
   }
   catch (const cxxopts::OptionException& e) {
-    std::cerr << "error parsing options: " << e.what() << std::endl;
-    exit(1);
+    Errors() << "error parsing options: " << e.what() << std::endl;
+    Fail(1);
   }
+  Stats().mark("parse");
+}
 
-  switch (kGenType) {
-  case kSimpleConnectedRandom:
-    generated_graph = SimpleConnectedRandomGraph(kNumNodes, kRandomEngine, kDensity, kMinCost, kMaxCost);
-    break;
-  case kRandom:
-    generated_graph = RandomGraph(kNumNodes, kRandomEngine, kDirected, kDensity, kMinCost, kMaxCost);
-    break;
-  case kGrid:
-    generated_graph = Random2DGridGraph(kNumNodes, kRandomEngine, kDirected, kDensity, kMinCost, kMaxCost);
-    break;
-  case kScaleFree:
-    generated_graph = RandomScaleFreeGraph(kNumNodes, kRandomEngine, kScaleFreeInitialNodes, kScaleFreeOffsetExponent, kScaleFreeMinDegree, kMinCost, kMaxCost);
-    break;
+//Generates the graph of the parsed settings with the id and cost types picked, the --stats report goes to report.
+int GenerateGraph(std::ostream& report = std::cerr) {
+  if (kPlan) {
+    std::fwrite(kPlanText.data(), 1, kPlanText.size(), OutputFile());
+    std::fflush(OutputFile());
+    return 0;
   }
+  int result;
+  if (kIdBits == 64) {
+    result = kWeightBits == 16 ? GenerateWith<std::int64_t, std::int16_t>() : GenerateWith<std::int64_t, std::int32_t>();
+  }
+  else {
+    result = kWeightBits == 16 ? GenerateWith<std::int32_t, std::int16_t>() : GenerateWith<std::int32_t, std::int32_t>();
+  }
+  if (Stats().enabled) {
+    ReportStats(report, Stats());
+  }
+  return result;
+}
 
-  switch (kOutFormat) {
-  case kPajek:
-    generated_graph.output_pajek();
-    break;
-  case kPmed:
-    generated_graph.output_pmed(kNumCenters);
+//Parses the options of a batch job or daemon request on the calling thread.
+void ParseJob(const std::vector<std::string>& options) {
+  std::vector<const char*> args(1, "GraphGen");
+  for (auto& arg : options) {
+    args.push_back(arg.c_str());
+  }
+  int argc = (int)args.size();
+  ParseOptions(argc, args.data(), true);
+}
+
+#ifdef __linux__
+//Runs the jobs one after the other, each on all threads, into a sink that only counts the output, and writes
+//the time, output size, peak memory and, in builds with GRAPHGEN_COUNT_ALLOCATIONS, allocations of every job
+//as JSON.
+int RunBenchmark() {
+  //every job is checked before any runs
+  for (auto& job : kBatchJobs) {
+    std::thread([&]() { ParseJob(job); }).join();
+  }
+  std::vector<BenchmarkResult> results;
+  for (auto& job : kBatchJobs) {
+    BenchmarkResult result;
+    for (auto& arg : job) {
+      result.name += (result.name.empty() ? "" : " ") + arg;
+    }
+    //a fresh thread starts from the default settings
+    std::thread([&]() {
+      ParseJob(job);
+      CountingSink sink;
+      std::FILE* out = sink.open();
+      OutputFile() = out;
+      ResetPeakRss();
+#ifdef GRAPHGEN_COUNT_ALLOCATIONS
+      long long allocations = AllocationCount();
+      long long allocated_bytes = AllocatedBytes();
+#endif
+      auto start = std::chrono::steady_clock::now();
+      GenerateGraph();
+      std::fflush(out);
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef GRAPHGEN_COUNT_ALLOCATIONS
+      result.allocations = AllocationCount() - allocations;
+      result.allocated_bytes = AllocatedBytes() - allocated_bytes;
+#endif
+      result.peak_rss_bytes = PeakRssBytes();
+      std::fclose(out);
+      result.bytes = sink.bytes;
+      result.edges = sink.lines - (kOutFormat == kPajek ? 2 : 1);
+    }).join();
+    char seconds[32];
+    std::snprintf(seconds, sizeof(seconds), "%8.3f s  ", result.seconds);
+    std::cerr << seconds << result.name << std::endl;
+    results.push_back(result);
+  }
+  if (kOutputPattern.empty()) {
+    WriteBenchmarkJson(std::cout, results, NumThreads());
   }
+  else {
+    std::ofstream out(kOutputPattern);
+    if (!out) {
+      Errors() << "Cannot open output file: " << kOutputPattern << std::endl;
+      Fail(2);
+    }
+    WriteBenchmarkJson(out, results, NumThreads());
+  }
+  if (!kBenchmarkBaseline.empty() && !CompareBenchmark(std::cerr, results, kBenchmarkBaseline)) {
+    Errors() << "Cannot open benchmark baseline: " << kBenchmarkBaseline << std::endl;
+    return 2;
+  }
+  return 0;
+}
+
+//Generates the graph of a daemon request into reply and its --stats report into stats, or returns false with
+//the error text in reply. The request runs on a fresh thread, so it starts from the default settings, and its
+//loops use the warm thread pool unless another request holds it. Whatever a request throws, running out of
+//memory included, is its own error reply, the daemon goes on serving.
+bool ServeRequest(const std::string& line, std::string& reply, std::string& stats) {
+  bool ok = false;
+  std::thread([&]() {
+    std::ostringstream errors;
+    kErrors = &errors;
+    kInRequest = true;
+    char* data = nullptr;
+    size_t size = 0;
+    std::FILE* out = nullptr;
+    try {
+      ParseJob(SplitArgs(line));
+      out = open_memstream(&data, &size);
+      if (out == nullptr) {
+        Errors() << "Cannot open output buffer" << std::endl;
+        Fail(2);
+      }
+      OutputFile() = out;
+      std::ostringstream report;
+      GenerateGraph(report);
+      std::fclose(out);
+      out = nullptr;
+      reply.assign(data, size);
+      stats = report.str();
+      ok = true;
+    }
+    catch (const RequestError&) {
+      reply = errors.str();
+    }
+    catch (const std::bad_alloc&) {
+      reply = "Out of memory";
+    }
+    catch (const std::exception& e) {
+      reply = e.what();
+    }
+    catch (...) {
+      reply = "Request failed";
+    }
+    if (out != nullptr) {
+      std::fclose(out);
+    }
+    std::free(data);
+  }).join();
+  return ok;
+}
+#endif
+
+int main(int argc, const char* argv[]) {
+  ParseOptions(argc, argv, false);
+#ifdef __linux__
+  if (!kServePath.empty()) {
+    return Serve(kServePath, ServeRequest);
+  }
+  if (kBenchmark) {
+    return RunBenchmark();
+  }
+#endif
+  if (kBatchJobs.empty()) {
+    return GenerateGraph();
+  }
+
+  //every job is checked before any runs, so a bad line stops the batch before it writes anything
+  RunBatch(kBatchJobs.size(), [&](size_t job) { ParseJob(kBatchJobs[job]); });
+  std::set<std::string> paths;
+  for (size_t job = 0; job < kBatchJobs.size(); ++job) {
+    if (!paths.insert(JobOutputName(GraphOptions(), kOutputPattern, kBatchJobs[job], job)).second) {
+      Errors() << "Jobs " << job << " and an earlier one write the same file, add {job} to the output pattern" << std::endl;
+      Fail(2);
+    }
+  }
+  RunBatch(kBatchJobs.size(), [&](size_t job) {
+    ParseJob(kBatchJobs[job]);
+    std::string path = JobOutputName(GraphOptions(), kOutputPattern, kBatchJobs[job], job);
+    std::FILE* out = std::fopen(path.c_str(), "wb");
+    if (out == nullptr) {
+      Errors() << "Cannot open output file: " << path << std::endl;
+      Fail(2);
+    }
+    OutputFile() = out;
+    GenerateGraph();
+    std::fclose(out);
+  });
+  return 0;
 }
 
@@ -0,0 +1,159 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+
+enum HugePages {
+  kHugePagesOff,
+  kHugePagesTransparent,
+  kHugePagesExplicit
+};
+
+//How the large arrays of a graph are backed, set from the command line before generating.
+inline HugePages& HugePageMode() {
+  static HugePages mode = kHugePagesTransparent;
+  return mode;
+}
+
+//Memory for one of the large arrays of a graph. On Linux a buffer of a few huge pages or more is mapped on
+//its own, 2 MB aligned, and backed by transparent huge pages, or by explicit ones from the hugetlb pool when
+//asked for and available. Elsewhere, and for small buffers, it comes from operator new. Nothing is touched
+//here, so every page lands on the NUMA node of the thread that writes it first.
+class LargeBuffer {
+public:
+  LargeBuffer() : data(nullptr), bytes(0), mapped(false) {}
+
+  explicit LargeBuffer(size_t size) : data(nullptr), bytes(size), mapped(false) {
+#ifdef __linux__
+    if (HugePageMode() != kHugePagesOff && size >= kHugePageBytes) {
+      bytes = (size + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+      data = map(bytes);
+      mapped = data != nullptr;
+    }
+#endif
+    if (data == nullptr) {
+      bytes = size;
+      data = ::operator new(size);
+    }
+  }
+
+  LargeBuffer(LargeBuffer&& other) : data(other.data), bytes(other.bytes), mapped(other.mapped) {
+    other.data = nullptr;
+  }
+
+  LargeBuffer& operator=(LargeBuffer&& other) {
+    std::swap(data, other.data);
+    std::swap(bytes, other.bytes);
+    std::swap(mapped, other.mapped);
+    return *this;
+  }
+
+  ~LargeBuffer() {
+    if (data == nullptr) {
+      return;
+    }
+#ifdef __linux__
+    if (mapped) {
+      munmap(data, bytes);
+      return;
+    }
+#endif
+    ::operator delete(data);
+  }
+
+  void* get() const {
+    return data;
+  }
+
+private:
+  static const size_t kHugePageBytes = (size_t)1 << 21;
+
+  void* data;
+  size_t bytes;
+  bool mapped;
+
+#ifdef __linux__
+  static void* map(size_t length) {
+    void* p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (HugePageMode() == kHugePagesExplicit) {
+      p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (p != MAP_FAILED) {
+      return p;
+    }
+    //one huge page more than needed, so the start can be moved to a huge page boundary
+    size_t padded = length + kHugePageBytes;
+    p = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      return nullptr;
+    }
+    char* start = (char*)p;
+    char* aligned = (char*)(((uintptr_t)start + kHugePageBytes - 1) & ~(uintptr_t)(kHugePageBytes - 1));
+    if (aligned != start) {
+      munmap(start, aligned - start);
+    }
+    if (aligned + length != start + padded) {
+      munmap(aligned + length, start + padded - (aligned + length));
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+    return aligned;
+  }
+#endif
+};
+
+//Fixed size array of T in a LargeBuffer. The items are constructed by ParallelFor in blocks of `grain`, so
+//with first touch the pages are interleaved over the NUMA nodes of the threads that took the blocks instead
+//of all landing on the node of the thread that built the graph. That spreads the bandwidth, it does not
+//place a vertex range on the node of the thread that later writes it: the blocks are handed out and stolen
+//dynamically, the pool threads are not pinned, and the writers take blocks of their own.
+template <typename T>
+class LargeArray {
+public:
+  LargeArray() : items(nullptr), count(0) {}
+
+  explicit LargeArray(size_t size, long long grain = 1 << 14) : memory(size * sizeof(T)), items((T*)memory.get()), count(size) {
+    ParallelFor(0, size, grain, [&](long long begin, long long end, long long) {
+      for (long long i = begin; i < end; ++i) {
+        new (items + i) T();
+      }
+    });
+  }
+
+  LargeArray(LargeArray&& other) : memory(std::move(other.memory)), items(other.items), count(other.count) {
+    other.items = nullptr;
+    other.count = 0;
+  }
+
+  LargeArray& operator=(LargeArray&& other) {
+    destroy();
+    memory = std::move(other.memory);
+    items = other.items;
+    count = other.count;
+    other.items = nullptr;
+    other.count = 0;
+    return *this;
+  }
+
+  ~LargeArray() {
+    destroy();
+  }
+
+  T* begin() const { return items; }
+  T* end() const { return items + count; }
+  size_t size() const { return count; }
+  T& operator[](size_t i) const { return items[i]; }
+
+private:
+  LargeBuffer memory;
+  T* items;
+  size_t count;
+
+  void destroy() {
+    for (size_t i = 0; i < count; ++i) {
+      items[i].~T();
+    }
+  }
+};
@@ -0,0 +1,381 @@
+#pragma once
+#include "stdafx.h"
+
+//Threads of the parallel loops, 0 for the hardware concurrency. Set with --threads before the first loop.
+inline unsigned& ThreadSetting() {
+  static unsigned threads = 0;
+  return threads;
+}
+
+inline unsigned NumThreads() {
+  unsigned threads = ThreadSetting() != 0 ? ThreadSetting() : std::thread::hardware_concurrency();
+  return threads == 0 ? 1 : threads;
+}
+
+//Persistent workers the parallel loops run on, the thread starting a loop works along. A loop's blocks are
+//split into one contiguous range per thread. Every thread takes blocks from the front of its own range, and
+//one that runs dry steals the back half of the largest range left, so a few expensive blocks, like the hubs
+//of a scale-free graph, do not hold up the loop. An ordered loop instead hands out its blocks in increasing
+//order from a shared counter, for consumers that can only run a bounded distance ahead, like OrderedOutput.
+class ThreadPool {
+public:
+  static ThreadPool& Instance() {
+    //never destroyed, exit() may be called while a loop is running
+    static ThreadPool* pool = new ThreadPool(NumThreads());
+    return *pool;
+  }
+
+  unsigned size() const {
+    return num_threads;
+  }
+
+  //Runs body(block) for every block of [0, num_blocks). Returns false, without running anything, when
+  //called from inside a loop or while another thread runs one; the caller then runs the blocks itself.
+  //The first exception of a block is thrown again here once every thread is out of the loop, the blocks
+  //not started by then are skipped.
+  template <typename F>
+  bool run(long long num_blocks, bool ordered, F& body) {
+    if (InLoop()) {
+      return false;
+    }
+    std::unique_lock<std::mutex> running(run_mutex, std::try_to_lock);
+    if (!running) {
+      return false;
+    }
+    job = [](void* context, long long block) { (*(F*)context)(block); };
+    job_context = &body;
+    error = nullptr;
+    failed = false;
+    this->ordered = ordered;
+    next_block = 0;
+    total_blocks = num_blocks;
+    for (unsigned t = 0; t < num_threads; ++t) {
+      std::lock_guard<std::mutex> lock(ranges[t].mutex);
+      ranges[t].next = num_blocks * t / num_threads;
+      ranges[t].end = num_blocks * (t + 1) / num_threads;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      generation++;
+      active = num_threads - 1;
+    }
+    wake.notify_all();
+    work(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return active == 0; });
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    return true;
+  }
+
+  static bool& InLoop() {
+    static thread_local bool in_loop = false;
+    return in_loop;
+  }
+
+private:
+  //padded so the ranges of different threads do not share a cache line
+  struct Range {
+    std::mutex mutex;
+    long long next = 0;
+    long long end = 0;
+    char padding[64];
+  };
+
+  unsigned num_threads;
+  std::unique_ptr<Range[]> ranges;
+  std::vector<std::thread> workers;
+  std::mutex run_mutex;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  unsigned long long generation = 0;
+  unsigned active = 0;
+  void (*job)(void*, long long) = nullptr;
+  void* job_context = nullptr;
+  bool ordered = false;
+  std::atomic<long long> next_block;
+  long long total_blocks = 0;
+  std::exception_ptr error;
+  std::atomic<bool> failed;
+
+  explicit ThreadPool(unsigned threads) : num_threads(threads), ranges(new Range[threads]), next_block(0), failed(false) {
+    for (unsigned t = 1; t < num_threads; ++t) {
+      workers.emplace_back([this, t]() { worker(t); });
+    }
+  }
+
+  void worker(unsigned id) {
+    unsigned long long seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&]() { return generation != seen; });
+        seen = generation;
+      }
+      work(id);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--active == 0) {
+        done.notify_all();
+      }
+    }
+  }
+
+  void work(unsigned id) {
+    InLoop() = true;
+    long long block;
+    while (ordered ? take_next(block) : take(id, block) || steal(id, block)) {
+      if (failed) {
+        continue;
+      }
+      try {
+        job(job_context, block);
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        failed = true;
+      }
+    }
+    InLoop() = false;
+  }
+
+  bool take_next(long long& block) {
+    block = next_block++;
+    return block < total_blocks;
+  }
+
+  bool take(unsigned id, long long& block) {
+    std::lock_guard<std::mutex> lock(ranges[id].mutex);
+    if (ranges[id].next == ranges[id].end) {
+      return false;
+    }
+    block = ranges[id].next++;
+    return true;
+  }
+
+  //takes the back half of the largest range left, keeping its first block and the rest as its own range
+  bool steal(unsigned id, long long& block) {
+    for (;;) {
+      unsigned victim = id;
+      long long most = 0;
+      for (unsigned t = 0; t < num_threads; ++t) {
+        std::lock_guard<std::mutex> lock(ranges[t].mutex);
+        if (ranges[t].end - ranges[t].next > most) {
+          most = ranges[t].end - ranges[t].next;
+          victim = t;
+        }
+      }
+      if (most == 0) {
+        return false;
+      }
+      long long first;
+      long long end;
+      {
+        std::lock_guard<std::mutex> lock(ranges[victim].mutex);
+        long long left = ranges[victim].end - ranges[victim].next;
+        if (left == 0) {
+          continue;
+        }
+        first = ranges[victim].end - (left + 1) / 2;
+        end = ranges[victim].end;
+        ranges[victim].end = first;
+      }
+      std::lock_guard<std::mutex> lock(ranges[id].mutex);
+      block = first;
+      ranges[id].next = first + 1;
+      ranges[id].end = end;
+      return true;
+    }
+  }
+};
+
+template <typename F>
+void RunBlocks(long long begin, long long end, long long grain, bool ordered, F& fn) {
+  if (end <= begin) {
+    return;
+  }
+  long long num_blocks = (end - begin + grain - 1) / grain;
+  auto body = [&](long long block) {
+    long long block_begin = begin + block * grain;
+    fn(block_begin, std::min(block_begin + grain, end), block);
+  };
+  if (num_blocks == 1 || !ThreadPool::Instance().run(num_blocks, ordered, body)) {
+    for (long long block = 0; block < num_blocks; ++block) {
+      body(block);
+    }
+  }
+}
+
+//Runs fn(block_begin, block_end, block) for every block of `grain` items in [begin, end) on the thread pool.
+//Blocks are handed out dynamically, but their boundaries depend only on `grain`, so
+//generators that seed one engine per block produce the same graph on any number of threads.
+template <typename F>
+void ParallelFor(long long begin, long long end, long long grain, F fn) {
+  RunBlocks(begin, end, grain, false, fn);
+}
+
+//ParallelFor that starts the blocks in increasing order, for writers that emit them in order.
+template <typename F>
+void ParallelForOrdered(long long begin, long long end, long long grain, F fn) {
+  RunBlocks(begin, end, grain, true, fn);
+}
+
+//Share of the generation done by this process when it is split over several, set with --rank and --num-ranks.
+struct RankSettings {
+  long long rank = 0;
+  long long num_ranks = 1;
+};
+
+inline RankSettings& Ranks() {
+  static RankSettings settings;
+  return settings;
+}
+
+//First and one past the last of num_blocks blocks that belong to this rank.
+inline std::pair<long long, long long> RankBlocks(long long num_blocks) {
+  return std::make_pair(num_blocks * Ranks().rank / Ranks().num_ranks, num_blocks * (Ranks().rank + 1) / Ranks().num_ranks);
+}
+
+//ParallelFor over this rank's contiguous slice of the blocks of `grain` items in [0, end). The blocks keep
+//their global numbers, so generators seeding one engine per block produce, over all ranks together, exactly
+//the graph of a single process.
+template <typename F>
+void ParallelForSlice(long long end, long long grain, F fn) {
+  auto blocks = RankBlocks((end + grain - 1) / grain);
+  ParallelFor(blocks.first, blocks.second, 1, [&](long long block, long long, long long) {
+    long long begin = block * grain;
+    fn(begin, std::min(begin + grain, end), block);
+  });
+}
+
+//Independent random stream for one block of a parallel generator.
+inline std::default_random_engine BlockEngine(unsigned seed, long long block) {
+  std::seed_seq seq{ seed, (unsigned)block, (unsigned)(block >> 32) };
+  return std::default_random_engine(seq);
+}
+
+//Number of items of a that come first in the merge of sorted ranges a and b up to position diag.
+template <typename T>
+size_t MergePathSplit(const T* a, size_t na, const T* b, size_t nb, size_t diag) {
+  size_t lo = diag > nb ? diag - nb : 0;
+  size_t hi = std::min(diag, na);
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (!(b[diag - mid - 1] < a[mid])) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+//Sorts chunks in parallel, then merges pairs of runs level by level. Every merge is cut along
+//its merge path into one segment per thread, so the last levels stay parallel as well.
+template <typename T>
+void ParallelSort(std::vector<T>& data) {
+  const size_t kMinChunk = 1 << 16;
+  size_t n = data.size();
+  size_t chunks = std::min<size_t>(NumThreads(), n / kMinChunk);
+  if (chunks <= 1) {
+    std::sort(data.begin(), data.end());
+    return;
+  }
+  std::vector<size_t> bounds(chunks + 1);
+  for (size_t c = 0; c <= chunks; ++c) {
+    bounds[c] = n * c / chunks;
+  }
+  ParallelFor(0, chunks, 1, [&](long long c, long long, long long) {
+    std::sort(data.begin() + bounds[c], data.begin() + bounds[c + 1]);
+  });
+
+  std::vector<T> buffer(n);
+  T* from = data.data();
+  T* to = buffer.data();
+  long long segments = NumThreads();
+  while (bounds.size() > 2) {
+    size_t runs = bounds.size() - 1;
+    long long pairs = (long long)(runs + 1) / 2;
+    ParallelFor(0, pairs * segments, 1, [&](long long task, long long, long long) {
+      size_t p = (size_t)(task / segments);
+      size_t s = (size_t)(task % segments);
+      size_t begin = bounds[2 * p];
+      size_t middle = bounds[std::min(2 * p + 1, runs)];
+      size_t end = bounds[std::min(2 * p + 2, runs)];
+      size_t na = middle - begin;
+      size_t nb = end - middle;
+      size_t d0 = (na + nb) * s / segments;
+      size_t d1 = (na + nb) * (s + 1) / segments;
+      size_t i0 = MergePathSplit(from + begin, na, from + middle, nb, d0);
+      size_t i1 = MergePathSplit(from + begin, na, from + middle, nb, d1);
+      std::merge(from + begin + i0, from + begin + i1, from + middle + d0 - i0, from + middle + d1 - i1, to + begin + d0);
+    });
+    std::vector<size_t> merged;
+    for (size_t c = 0; c < bounds.size(); c += 2) {
+      merged.push_back(bounds[c]);
+    }
+    if (merged.back() != n) {
+      merged.push_back(n);
+    }
+    bounds.swap(merged);
+    std::swap(from, to);
+  }
+  if (from != data.data()) {
+    data.swap(buffer);
+  }
+}
+
+//Uniform shuffle that sends every item to a random cache sized bucket and then shuffles each bucket
+//on its own. Both passes are parallel and the result depends only on the seed.
+template <typename T>
+void ParallelShuffle(std::vector<T>& data, unsigned seed) {
+  const size_t kBucketSize = 1 << 16;
+  const long long kChunks = 64;
+  size_t n = data.size();
+  size_t buckets = n / kBucketSize;
+  if (buckets <= 1) {
+    auto engine = BlockEngine(seed, 0);
+    std::shuffle(data.begin(), data.end(), engine);
+    return;
+  }
+  long long chunk_size = (long long)((n + kChunks - 1) / kChunks);
+  std::vector<std::vector<size_t>> offsets(kChunks, std::vector<size_t>(buckets, 0));
+  ParallelFor(0, n, chunk_size, [&](long long begin, long long end, long long chunk) {
+    auto engine = BlockEngine(seed, chunk);
+    std::uniform_int_distribution<size_t> r_bucket(0, buckets - 1);
+    for (long long i = begin; i < end; ++i) {
+      offsets[chunk][r_bucket(engine)]++;
+    }
+  });
+  std::vector<size_t> bucket_start(buckets + 1, 0);
+  size_t position = 0;
+  for (size_t b = 0; b < buckets; ++b) {
+    bucket_start[b] = position;
+    for (long long c = 0; c < kChunks; ++c) {
+      size_t count = offsets[c][b];
+      offsets[c][b] = position;
+      position += count;
+    }
+  }
+  bucket_start[buckets] = n;
+
+  //same streams again, this time scattering
+  std::vector<T> scattered(n);
+  ParallelFor(0, n, chunk_size, [&](long long begin, long long end, long long chunk) {
+    auto engine = BlockEngine(seed, chunk);
+    std::uniform_int_distribution<size_t> r_bucket(0, buckets - 1);
+    for (long long i = begin; i < end; ++i) {
+      scattered[offsets[chunk][r_bucket(engine)]++] = data[i];
+    }
+  });
+  ParallelFor(0, buckets, 1, [&](long long b, long long, long long) {
+    auto engine = BlockEngine(seed, kChunks + b);
+    std::shuffle(scattered.begin() + bucket_start[b], scattered.begin() + bucket_start[b + 1], engine);
+  });
+  data.swap(scattered);
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+#include "Writer.hpp"
+
+enum Strategy {
+  kMaterialized,
+  kStreaming,
+  kSpilled
+};
+
+//Rough costs measured on one core, the time is only good to a small factor.
+const double kMegabyte = 1 << 20;
+const double kBaseBytes = 8 * kMegabyte;
+const double kArcSeconds = 6e-8;
+const double kSpillArcSeconds = 6e-8;
+const double kOutputByteSeconds = 4e-9;
+//smallest spill budget worth merging with, below it the runs get too many and too short
+const double kMinSpillBytes = 16 * kMegabyte;
+
+//Expected size of a run, filled in per generator from its parameters.
+struct Estimate {
+  double nodes = 0;
+  double arcs = 0;
+  //generating one arc, split over the threads of a parallel generator
+  double arc_seconds = kArcSeconds;
+  //the generator's own structures, needed however the arcs are stored
+  double aux_bytes = 0;
+  //work that does not grow with the arcs
+  double extra_seconds = 0;
+  bool parallel = true;
+  //lists grow by doubling instead of being sized up front, so they hold up to twice their arcs
+  bool grows_lists = false;
+  //the arcs are buffered as they are generated and then scattered into lists of their final size
+  bool buffers_arcs = false;
+  //written straight to the output, the arcs are never stored
+  bool streams = false;
+  //can be written straight to the output too, done when the graph does not fit into memory
+  bool can_stream = false;
+  //keeps every arc in structures of its own, spilling the graph would not bound its memory
+  bool keeps_arcs = false;
+  OutputFormat format = kPajek;
+};
+
+struct Plan {
+  Strategy strategy = kMaterialized;
+  double memory_bytes = 0;
+  double spill_bytes = 0;
+  double disk_bytes = 0;
+  double output_bytes = 0;
+  double seconds = 0;
+  bool fits = true;
+};
+
+//mean number of decimal digits of the integers 1..max
+inline double AverageDigits(double max) {
+  if (max < 1) {
+    return 1;
+  }
+  double digits = 0;
+  double low = 1;
+  for (int d = 1; low <= max; ++d, low *= 10) {
+    digits += d * (std::min(max, low * 10 - 1) - low + 1);
+  }
+  return digits / max;
+}
+
+//Bytes of the output, both formats write an edge as "source dest cost" and differ in their header.
+inline double OutputBytes(const Estimate& e, double cost_digits) {
+  double node_digits = std::floor(std::log10(std::max(e.nodes, 1.0))) + 1;
+  double header = e.format == kPajek ? 17 + node_digits : 2 * node_digits + std::floor(std::log10(std::max(e.arcs, 1.0))) + 3;
+  return header + e.arcs * (2 * AverageDigits(e.nodes) + cost_digits + 3);
+}
+
+//Picks the cheapest strategy that fits into max_memory bytes, 0 for no limit: the in-memory graph if it
+//fits, otherwise streaming if the generator can, otherwise spilling with what the generator leaves of the
+//budget. A streaming generator always streams.
+//spill_memory is the spill budget to plan with, 0 to take what is left.
+inline Plan MakePlan(const Estimate& e, double max_memory, bool force_spill, double spill_memory, int id_bytes, int weight_bytes, double cost_digits) {
+  Plan plan;
+  double threads = NumThreads();
+  double arc_bytes = std::ceil((id_bytes + weight_bytes) / 2.0) * 2;
+  double list_bytes = sizeof(void*) + 2 * id_bytes;
+  double spill_arc_bytes = std::ceil((2 * id_bytes + weight_bytes) / 2.0) * 2;
+  plan.output_bytes = OutputBytes(e, cost_digits);
+  double generate_seconds = e.arcs * e.arc_seconds / (e.parallel ? threads : 1);
+  double seconds = generate_seconds + e.extra_seconds;
+
+  double materialized = kBaseBytes + e.aux_bytes + e.nodes * (list_bytes + id_bytes) + e.arcs * arc_bytes * (e.grows_lists || e.buffers_arcs ? 2 : 1);
+  bool fits = max_memory == 0 || materialized <= max_memory;
+  if (e.streams || (e.can_stream && !force_spill && !fits)) {
+    plan.strategy = kStreaming;
+    plan.memory_bytes = kBaseBytes + e.aux_bytes;
+    //pmed needs the edge count up front, the edges are generated once more only to count them
+    plan.seconds = seconds + (e.format == kPmed ? generate_seconds : 0) + plan.output_bytes * kOutputByteSeconds / threads;
+  }
+  else {
+    if (e.keeps_arcs || (!force_spill && fits)) {
+      plan.strategy = kMaterialized;
+      plan.memory_bytes = materialized;
+      plan.seconds = seconds + plan.output_bytes * kOutputByteSeconds / threads;
+    }
+    else {
+      //runs are merged and formatted on one thread
+      plan.strategy = kSpilled;
+      plan.spill_bytes = spill_memory;
+      if (plan.spill_bytes == 0) {
+        plan.spill_bytes = max_memory == 0 ? 1024 * kMegabyte : max_memory - kBaseBytes - e.aux_bytes;
+      }
+      plan.spill_bytes = std::max(plan.spill_bytes, kMinSpillBytes);
+      plan.memory_bytes = kBaseBytes + e.aux_bytes + plan.spill_bytes;
+      plan.disk_bytes = e.arcs * spill_arc_bytes;
+      //and for pmed merged once more to count the edges
+      plan.seconds = seconds + e.arcs * kSpillArcSeconds * (e.format == kPmed ? 2 : 1) + plan.output_bytes * kOutputByteSeconds;
+    }
+  }
+  plan.fits = max_memory == 0 || plan.memory_bytes <= max_memory;
+  return plan;
+}
+
+inline void PrintPlan(std::ostream& out, const Estimate& e, const Plan& plan) {
+  const char* names[] = { "materialized", "streaming", "external" };
+  out << "strategy: " << names[plan.strategy] << std::endl;
+  out << "nodes: " << (long long)e.nodes << std::endl;
+  out << "edges: " << (long long)e.arcs << std::endl;
+  out << "memory: " << (long long)(plan.memory_bytes / kMegabyte) << " MB" << std::endl;
+  if (plan.strategy == kSpilled) {
+    out << "spill buffers: " << (long long)(plan.spill_bytes / kMegabyte) << " MB" << std::endl;
+    out << "scratch disk: " << (long long)(plan.disk_bytes / kMegabyte) << " MB" << std::endl;
+  }
+  out << "output: " << (long long)(plan.output_bytes / kMegabyte) << " MB" << std::endl;
+  out << "time: " << plan.seconds << " s" << std::endl;
+}
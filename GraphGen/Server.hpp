@@ -0,0 +1,172 @@
+#pragma once
+#include "stdafx.h"
+
+#ifdef __linux__
+//Next line sent by the client without its '\n', read through buffer. False once the client is gone.
+inline bool ReadLine(int fd, std::string& buffer, std::string& line) {
+  size_t end;
+  while ((end = buffer.find('\n')) == std::string::npos) {
+    char chunk[4096];
+    ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+    if (count <= 0) {
+      return false;
+    }
+    buffer.append(chunk, count);
+  }
+  line = buffer.substr(0, end);
+  buffer.erase(0, end + 1);
+  return true;
+}
+
+inline bool SendAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (count <= 0) {
+      return false;
+    }
+    sent += count;
+  }
+  return true;
+}
+
+//Answers requests on a Unix domain socket at path until SIGINT or SIGTERM, then removes the socket. A request
+//is one line of options and is answered with "OK <bytes>\n" followed by the graph, or with "ERROR <message>\n".
+//A request asking for --stats gets "STATS <bytes>\n" and the report first. handle(line, reply, stats) puts the
+//graph in reply and the report, if any, in stats, or returns false with the error text in reply. Every client
+//is served on a thread of its own and may send any number of requests over its connection. At most
+//kMaxClients are served at once, the others wait in the listen backlog. On a signal the connections are shut
+//down and their threads joined once their current request is answered. A socket left at path by an earlier
+//daemon is replaced, anything else there is left alone.
+template <typename Handler>
+int Serve(const std::string& path, Handler handle) {
+  const size_t kMaxClients = 64;
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Socket path is too long: " << path << std::endl;
+    return 2;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size());
+  struct stat existing;
+  if (lstat(path.c_str(), &existing) == 0) {
+    if (!S_ISSOCK(existing.st_mode)) {
+      std::cerr << "Not a socket, not replacing it: " << path << std::endl;
+      return 2;
+    }
+    unlink(path.c_str());
+  }
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (server < 0 || bind(server, (sockaddr*)&address, sizeof(address)) < 0 || listen(server, 64) < 0) {
+    std::cerr << "Cannot listen on socket: " << path << std::endl;
+    return 2;
+  }
+  //the signals may land on any thread, the handler only wakes the accepting loop through a pipe
+  static int stop[2];
+  if (pipe(stop) < 0) {
+    std::cerr << "Cannot create pipe: " << std::strerror(errno) << std::endl;
+    close(server);
+    unlink(path.c_str());
+    return 2;
+  }
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = [](int) {
+    char byte = 0;
+    ssize_t written = write(stop[1], &byte, 1);
+    (void)written;
+  };
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  //the connections being served, a thread marks its own done once its client is closed
+  struct Connection {
+    int fd;
+    std::thread thread;
+    std::atomic<bool> done{ false };
+  };
+  std::list<Connection> connections;
+  std::mutex connections_mutex;
+  for (;;) {
+    for (auto it = connections.begin(); it != connections.end();) {
+      if (it->done) {
+        it->thread.join();
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        it = connections.erase(it);
+      }
+      else {
+        ++it;
+      }
+    }
+    //while every slot is taken only the signal is waited for, and the slots are checked again now and then
+    bool full = connections.size() >= kMaxClients;
+    pollfd ready[2] = { { stop[0], POLLIN, 0 }, { server, POLLIN, 0 } };
+    if (poll(ready, full ? 1 : 2, full ? 100 : -1) < 0) {
+      continue;
+    }
+    if (ready[0].revents != 0) {
+      break;
+    }
+    if (full || ready[1].revents == 0) {
+      continue;
+    }
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    connections.emplace_back();
+    Connection& connection = connections.back();
+    connection.fd = client;
+    connection.thread = std::thread([client, handle, &connection, &connections_mutex]() mutable {
+      std::string buffer;
+      std::string line;
+      std::string reply;
+      std::string stats;
+      while (ReadLine(client, buffer, line)) {
+        bool ok = handle(line, reply, stats);
+        if (!stats.empty()) {
+          if (!SendAll(client, "STATS " + std::to_string(stats.size()) + "\n") || !SendAll(client, stats)) {
+            break;
+          }
+          stats.clear();
+        }
+        if (ok) {
+          if (!SendAll(client, "OK " + std::to_string(reply.size()) + "\n") || !SendAll(client, reply)) {
+            break;
+          }
+        }
+        else {
+          //one line, whatever the handler wrote
+          std::replace(reply.begin(), reply.end(), '\n', ' ');
+          while (!reply.empty() && reply.back() == ' ') {
+            reply.pop_back();
+          }
+          if (!SendAll(client, "ERROR " + reply + "\n")) {
+            break;
+          }
+        }
+        std::string().swap(reply);
+      }
+      std::lock_guard<std::mutex> lock(connections_mutex);
+      close(client);
+      connection.done = true;
+    });
+  }
+  close(server);
+  unlink(path.c_str());
+  //ends the reads of the idle connections, a request being generated is answered first
+  {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    for (auto& connection : connections) {
+      if (!connection.done) {
+        shutdown(connection.fd, SHUT_RDWR);
+      }
+    }
+  }
+  for (auto& connection : connections) {
+    connection.thread.join();
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+#include "stdafx.h"
+#include "Benchmark.hpp"
+
+//CPU time of the whole process, all threads of the pool included.
+inline double CpuSeconds() {
+#ifdef __linux__
+  timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+  return (double)std::clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+//CPU time of the calling thread alone.
+inline double ThreadCpuSeconds() {
+#ifdef __linux__
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+#else
+  return 0;
+#endif
+}
+
+struct PhaseTime {
+  std::string name;
+  double wall_seconds;
+  double cpu_seconds;
+};
+
+//What --stats reports about the graph generated on this thread. The counters are bumped once per block or once
+//per generator whether the report is asked for or not, only the clocks are left alone when it is not.
+struct RunStats {
+  bool enabled = false;
+  bool json = false;
+  std::vector<PhaseTime> phases;
+  //edges and bytes handed to the output
+  long long edges = 0;
+  long long bytes = 0;
+  //Only the rejection sampling generators, scalefree and csrandom, count their draws, the report leaves the
+  //fields out for the others.
+  bool sampled = false;
+  long long draws = 0;
+  long long rejected = 0;
+  //time the writes of the running phase took, for streaming generators that format and write as they go
+  double write_wall_seconds = 0;
+  double write_cpu_seconds = 0;
+
+  //starts timing the next phase
+  void restart() {
+    wall_start = std::chrono::steady_clock::now();
+    cpu_start = CpuSeconds();
+  }
+
+  //ends the phase started by the last restart or mark and starts the next
+  void mark(const char* name) {
+    if (!enabled) {
+      return;
+    }
+    auto wall_now = std::chrono::steady_clock::now();
+    double cpu_now = CpuSeconds();
+    phases.push_back({ name, std::chrono::duration<double>(wall_now - wall_start).count(), cpu_now - cpu_start });
+    wall_start = wall_now;
+    cpu_start = cpu_now;
+    write_wall_seconds = 0;
+    write_cpu_seconds = 0;
+  }
+
+  //Ends a phase that generated and wrote the edges together, as a generate phase and an output phase of the
+  //time its writes took, so the two do not overlap.
+  void mark_stream() {
+    if (!enabled) {
+      return;
+    }
+    double write_wall = write_wall_seconds;
+    double write_cpu = write_cpu_seconds;
+    mark("generate");
+    PhaseTime& generate = phases.back();
+    write_wall = std::min(write_wall, generate.wall_seconds);
+    write_cpu = std::min(write_cpu, generate.cpu_seconds);
+    generate.wall_seconds -= write_wall;
+    generate.cpu_seconds -= write_cpu;
+    phases.push_back({ "output", write_wall, write_cpu });
+  }
+
+  void add_samples(long long sample_draws, long long sample_rejected) {
+    sampled = true;
+    draws += sample_draws;
+    rejected += sample_rejected;
+  }
+
+private:
+  std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+  double cpu_start = 0;
+};
+
+inline RunStats& Stats() {
+  static thread_local RunStats stats;
+  return stats;
+}
+
+//Writes the report of --stats in one piece, so the reports of parallel batch jobs do not interleave.
+inline void ReportStats(std::ostream& out, const RunStats& stats) {
+  double generate_seconds = 0;
+  double output_seconds = 0;
+  for (auto& phase : stats.phases) {
+    if (phase.name != "parse") {
+      generate_seconds += phase.name == "output" ? 0 : phase.wall_seconds;
+      output_seconds += phase.name == "generate" ? 0 : phase.wall_seconds;
+    }
+  }
+  double edges_per_second = generate_seconds > 0 ? stats.edges / generate_seconds : 0;
+  double bytes_per_second = output_seconds > 0 ? stats.bytes / output_seconds : 0;
+  long long peak_rss_bytes = 0;
+#ifdef __linux__
+  peak_rss_bytes = PeakRssBytes();
+#endif
+  std::ostringstream report;
+  char text[128];
+  if (stats.json) {
+    report << "{\"phases\": [";
+    for (size_t i = 0; i < stats.phases.size(); ++i) {
+      std::snprintf(text, sizeof(text), "{\"name\": \"%s\", \"wall_seconds\": %.6f, \"cpu_seconds\": %.6f}", stats.phases[i].name.c_str(), stats.phases[i].wall_seconds, stats.phases[i].cpu_seconds);
+      report << (i > 0 ? ", " : "") << text;
+    }
+    report << "], \"edges\": " << stats.edges << ", \"bytes\": " << stats.bytes << ", \"edges_per_second\": " << (long long)edges_per_second
+           << ", \"bytes_per_second\": " << (long long)bytes_per_second;
+    if (stats.sampled) {
+      report << ", \"draws\": " << stats.draws << ", \"rejected\": " << stats.rejected;
+    }
+    if (peak_rss_bytes > 0) {
+      report << ", \"peak_rss_bytes\": " << peak_rss_bytes;
+    }
+    report << "}" << std::endl;
+  }
+  else {
+    report << "phase          wall s     cpu s" << std::endl;
+    for (auto& phase : stats.phases) {
+      std::snprintf(text, sizeof(text), "%-10s %10.3f %9.3f", phase.name.c_str(), phase.wall_seconds, phase.cpu_seconds);
+      report << text << std::endl;
+    }
+    std::snprintf(text, sizeof(text), "edges      %lld, %.0f per second generated", stats.edges, edges_per_second);
+    report << text << std::endl;
+    std::snprintf(text, sizeof(text), "bytes      %lld, %.0f per second written", stats.bytes, bytes_per_second);
+    report << text << std::endl;
+    if (stats.sampled) {
+      std::snprintf(text, sizeof(text), "draws      %lld, %lld samples rejected", stats.draws, stats.rejected);
+      report << text << std::endl;
+    }
+    if (peak_rss_bytes > 0) {
+      report << "peak rss   " << (peak_rss_bytes >> 20) << " MB" << std::endl;
+    }
+  }
+  out << report.str() << std::flush;
+}
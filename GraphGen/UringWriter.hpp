@@ -0,0 +1,251 @@
+#pragma once
+#include "stdafx.h"
+
+enum OutputBackend {
+  kStdioOutput,
+  kUringOutput
+};
+
+//How the edge writers hand their text to the kernel, set from the command line before generating.
+inline OutputBackend& OutputBackendMode() {
+  static OutputBackend backend = kStdioOutput;
+  return backend;
+}
+
+//Writes large buffers to a regular file through io_uring, with up to kDepth of them in flight at increasing
+//offsets, so the thread handing them over goes back to formatting instead of waiting in write(). Queued
+//buffers are handed to the kernel kSubmitBatch at a time, or together with the wait for a free slot, so
+//there is not one io_uring_enter per buffer. The file is registered as a fixed file when the kernel allows
+//it. Buffers are written from the caller's strings, the io_uring is driven with raw system calls, no
+//liburing needed.
+class UringWriter {
+public:
+  UringWriter() {}
+
+  ~UringWriter() {
+    finish();
+#ifdef IORING_FEAT_RW_CUR_POS
+    if (ring_fd >= 0) {
+      munmap(sq_ring, sq_ring_bytes);
+      if (cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_bytes);
+      }
+      munmap(sqes, sqes_bytes);
+      close(ring_fd);
+    }
+#endif
+  }
+
+  //Starts writing at the current position of fd. False when io_uring is not available, or fd is not a
+  //seekable regular file or was opened with O_APPEND, where writes at explicit offsets would not land in
+  //order, the caller then writes by itself.
+  bool open(int fd) {
+#ifdef IORING_FEAT_RW_CUR_POS
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+      return false;
+    }
+    int flags = fcntl(fd, F_GETFL);
+    long long start = lseek(fd, 0, SEEK_CUR);
+    if (flags < 0 || (flags & O_APPEND) != 0 || start < 0) {
+      return false;
+    }
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_fd = (int)syscall(__NR_io_uring_setup, kDepth, &params);
+    if (ring_fd < 0) {
+      return false;
+    }
+    sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_bytes = cq_ring_bytes = std::max(sq_ring_bytes, cq_ring_bytes);
+    }
+    sq_ring = mmap(nullptr, sq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    sqes_bytes = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = (io_uring_sqe*)mmap(nullptr, sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+      std::cerr << "Cannot map io_uring, falling back to stdio" << std::endl;
+      close(ring_fd);
+      ring_fd = -1;
+      return false;
+    }
+    char* sq = (char*)sq_ring;
+    char* cq = (char*)cq_ring;
+    sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    sq_array = (unsigned*)(sq + params.sq_off.array);
+    cq_head = (unsigned*)(cq + params.cq_off.head);
+    cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    file_fd = fd;
+    fixed_file = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES, &file_fd, 1) == 0;
+    offset = start;
+    for (unsigned i = 0; i < kDepth; ++i) {
+      free_slots.push_back(i);
+    }
+    return true;
+#else
+    (void)fd;
+    return false;
+#endif
+  }
+
+  //Queues data to be written after everything queued before, waits only when kDepth buffers are in flight.
+  //After an error the data is dropped.
+  void write(std::string data) {
+#ifdef IORING_FEAT_RW_CUR_POS
+    if (data.empty() || !write_error.empty()) {
+      return;
+    }
+    while (free_slots.empty() && !ring_failed) {
+      reap(1);
+    }
+    if (!write_error.empty()) {
+      return;
+    }
+    unsigned slot = free_slots.back();
+    free_slots.pop_back();
+    slots[slot].data = std::move(data);
+    slots[slot].written = 0;
+    slots[slot].offset = offset;
+    offset += slots[slot].data.size();
+    queue(slot);
+    if (queued >= kSubmitBatch) {
+      enter(0);
+    }
+#else
+    (void)data;
+#endif
+  }
+
+  //Waits for every write and leaves the file position at the end of the data.
+  void finish() {
+#ifdef IORING_FEAT_RW_CUR_POS
+    if (ring_fd < 0) {
+      return;
+    }
+    if (queued > 0) {
+      enter(0);
+    }
+    while (free_slots.size() < kDepth && !ring_failed) {
+      reap(1);
+    }
+    lseek(file_fd, offset, SEEK_SET);
+#endif
+  }
+
+  //first error of the writes, empty if there was none
+  const std::string& error() const {
+    return write_error;
+  }
+
+private:
+  static const unsigned kDepth = 8;
+  static const unsigned kSubmitBatch = 4;
+
+  struct Slot {
+    std::string data;
+    size_t written = 0;
+    long long offset = 0;
+  };
+
+  Slot slots[kDepth];
+  std::vector<unsigned> free_slots;
+  int ring_fd = -1;
+  int file_fd = -1;
+  bool fixed_file = false;
+  long long offset = 0;
+  //submission entries written to the ring but not yet handed to the kernel
+  unsigned queued = 0;
+  std::string write_error;
+  //the kernel no longer takes requests, the writes in flight are given up
+  bool ring_failed = false;
+
+#ifdef IORING_FEAT_RW_CUR_POS
+  void* sq_ring = nullptr;
+  void* cq_ring = nullptr;
+  size_t sq_ring_bytes = 0;
+  size_t cq_ring_bytes = 0;
+  io_uring_sqe* sqes = nullptr;
+  size_t sqes_bytes = 0;
+  unsigned* sq_tail = nullptr;
+  unsigned sq_mask = 0;
+  unsigned* sq_array = nullptr;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned cq_mask = 0;
+  io_uring_cqe* cqes = nullptr;
+
+  //puts the unwritten rest of a slot on the submission ring, the next enter hands it to the kernel
+  void queue(unsigned slot) {
+    Slot& s = slots[slot];
+    unsigned tail = *sq_tail;
+    unsigned index = tail & sq_mask;
+    io_uring_sqe& sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITE;
+    sqe.fd = fixed_file ? 0 : file_fd;
+    sqe.flags = fixed_file ? IOSQE_FIXED_FILE : 0;
+    sqe.addr = (unsigned long long)(s.data.data() + s.written);
+    sqe.len = (unsigned)(s.data.size() - s.written);
+    sqe.off = s.offset + s.written;
+    sqe.user_data = slot;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    queued++;
+  }
+
+  void fail(const std::string& message) {
+    if (write_error.empty()) {
+      write_error = message;
+    }
+  }
+
+  //submits everything queued and waits for min_complete completions in the same call
+  void enter(unsigned min_complete) {
+    while (!ring_failed) {
+      long result = syscall(__NR_io_uring_enter, ring_fd, queued, min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+      if (result >= 0) {
+        queued -= std::min(queued, (unsigned)result);
+        return;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        fail(std::string("io_uring_enter failed: ") + std::strerror(errno));
+        ring_failed = true;
+      }
+    }
+  }
+
+  //Waits for at least min_complete completions and frees their slots, queueing the rest of short writes. A
+  //failed write frees its slot too, the others in flight are still waited for.
+  void reap(unsigned min_complete) {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+      enter(min_complete);
+    }
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      io_uring_cqe& cqe = cqes[head & cq_mask];
+      unsigned slot = (unsigned)cqe.user_data;
+      int result = cqe.res;
+      __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+      if (result <= 0 && result != -EINTR && result != -EAGAIN) {
+        fail(std::string("Cannot write output: ") + std::strerror(result == 0 ? ENOSPC : -result));
+      }
+      slots[slot].written += result > 0 ? result : 0;
+      if (slots[slot].written < slots[slot].data.size() && write_error.empty()) {
+        queue(slot);
+      }
+      else {
+        std::string().swap(slots[slot].data);
+        free_slots.push_back(slot);
+      }
+    }
+  }
+#endif
+};
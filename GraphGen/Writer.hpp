@@ -0,0 +1,236 @@
+#pragma once
+#include "stdafx.h"
+#include "Parallel.hpp"
+#include "UringWriter.hpp"
+#include "Stats.hpp"
+
+enum OutputFormat {
+  kPajek,
+  kPmed,
+};
+
+//Where the graphs generated on this thread are written, stdout unless a batch job gives it a file of its own.
+inline std::FILE*& OutputFile() {
+  static thread_local std::FILE* out = stdout;
+  return out;
+}
+
+//First write error of the output backend on this thread, for the caller to report, empty if there was none.
+inline std::string& OutputError() {
+  static thread_local std::string error;
+  return error;
+}
+
+//Edge lines of one block of sources. Numbers are formatted by hand, this is the inner loop of every writer.
+class EdgeText {
+public:
+  std::string text;
+  long long lines = 0;
+
+  void add(long long source, long long dest, long long cost) {
+    char line[64];
+    int length = format(line, source + 1);
+    line[length++] = ' ';
+    length += format(line + length, dest + 1);
+    line[length++] = ' ';
+    length += format(line + length, cost);
+    line[length++] = '\n';
+    text.append(line, length);
+    lines++;
+  }
+
+private:
+  static int format(char* out, long long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long long rest = value < 0 ? 0 - (unsigned long long)value : (unsigned long long)value;
+    do {
+      digits[count++] = (char)('0' + rest % 10);
+      rest /= 10;
+    } while (rest != 0);
+    int length = 0;
+    if (value < 0) {
+      out[length++] = '-';
+    }
+    while (count > 0) {
+      out[length++] = digits[--count];
+    }
+    return length;
+  }
+};
+
+//Writes numbered blocks in block order, whatever order they are finished in. At most `window` blocks
+//wait in memory, a thread that runs further ahead blocks until the output catches up. With the io_uring
+//backend and a regular file the blocks are gathered into large buffers that are written asynchronously.
+//With `timed` the wall and CPU time spent writing is added up for --stats.
+class OrderedOutput {
+public:
+  OrderedOutput(std::FILE* out, long long window, long long first = 0, bool timed = false) : out(out), window(window), next(first), uring_active(false), timed(timed) {
+#ifdef __linux__
+    if (OutputBackendMode() == kUringOutput) {
+      std::fflush(out);
+      uring_active = uring.open(fileno(out));
+    }
+#endif
+  }
+
+  void write(long long block, std::string text) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ready.wait(lock, [&]() { return block < next + window; });
+    pending[block] = std::move(text);
+    if (pending.begin()->first != next) {
+      return;
+    }
+    WriteTimer timer(*this);
+    while (!pending.empty() && pending.begin()->first == next) {
+      emit(pending.begin()->second);
+      pending.erase(pending.begin());
+      next++;
+    }
+    ready.notify_all();
+  }
+
+  //writes what is still gathered and waits for the asynchronous writes
+  void finish() {
+    if (uring_active) {
+      WriteTimer timer(*this);
+      uring.write(std::move(batch));
+      uring.finish();
+    }
+  }
+
+  std::string error() const {
+    return uring_active ? uring.error() : std::string();
+  }
+
+  //time spent writing, added up when timed
+  double write_wall_seconds = 0;
+  double write_cpu_seconds = 0;
+
+private:
+  static const size_t kBatchBytes = 1 << 20;
+
+  std::FILE* out;
+  long long window;
+  long long next;
+  std::map<long long, std::string> pending;
+  std::mutex mutex;
+  std::condition_variable ready;
+  bool uring_active;
+  UringWriter uring;
+  std::string batch;
+  bool timed;
+
+  //adds the time until it is destroyed to the write time when timed
+  struct WriteTimer {
+    OrderedOutput& output;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start;
+
+    explicit WriteTimer(OrderedOutput& output) : output(output), cpu_start(0) {
+      if (output.timed) {
+        wall_start = std::chrono::steady_clock::now();
+        cpu_start = ThreadCpuSeconds();
+      }
+    }
+
+    ~WriteTimer() {
+      if (output.timed) {
+        output.write_wall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        output.write_cpu_seconds += ThreadCpuSeconds() - cpu_start;
+      }
+    }
+  };
+
+  void emit(std::string& text) {
+    if (!uring_active) {
+      std::fwrite(text.data(), 1, text.size(), out);
+      return;
+    }
+    if (batch.empty() && text.size() >= kBatchBytes) {
+      uring.write(std::move(text));
+      return;
+    }
+    batch += text;
+    if (batch.size() >= kBatchBytes) {
+      uring.write(std::move(batch));
+      batch = std::string();
+    }
+  }
+};
+
+inline void WriteHeader(std::FILE* out, OutputFormat format, long long num_nodes, long long num_edges, long long num_centers) {
+  std::string header;
+  switch (format) {
+  case kPajek:
+    header = "*vertices " + std::to_string(num_nodes) + "\n*arcs\n";
+    break;
+  case kPmed:
+    header = std::to_string(num_nodes) + ' ' + std::to_string(num_edges) + ' ' + std::to_string(num_centers) + '\n';
+    break;
+  }
+  std::fwrite(header.data(), 1, header.size(), out);
+  Stats().bytes += header.size();
+}
+
+//Formats the edges of the sources in blocks [first_block, last_block) of `grain` sources of [0, num_nodes)
+//in parallel, edges(begin, end, block, text) adds the lines of one block to text.
+template <typename BlockFn>
+void WriteEdgeBlocks(std::FILE* out, long long num_nodes, long long grain, long long first_block, long long last_block, BlockFn edges) {
+  OrderedOutput ordered(out, 4 * (long long)NumThreads(), first_block, Stats().enabled);
+  std::atomic<long long> lines(0);
+  std::atomic<long long> bytes(0);
+  ParallelForOrdered(first_block, last_block, 1, [&](long long block, long long, long long) {
+    long long begin = block * grain;
+    EdgeText text;
+    try {
+      edges(begin, std::min(begin + grain, num_nodes), block, text);
+    }
+    catch (...) {
+      //the blocks after this one must not wait for it forever
+      ordered.write(block, std::string());
+      throw;
+    }
+    lines += text.lines;
+    bytes += text.text.size();
+    ordered.write(block, std::move(text.text));
+  });
+  ordered.finish();
+  std::fflush(out);
+  if (OutputError().empty()) {
+    OutputError() = ordered.error();
+  }
+  //the blocks are formatted on the pool, the counts go to the thread that asked for the graph
+  Stats().edges += lines;
+  Stats().bytes += bytes;
+  Stats().write_wall_seconds += ordered.write_wall_seconds;
+  Stats().write_cpu_seconds += ordered.write_cpu_seconds;
+}
+
+template <typename BlockFn>
+void WriteEdgeBlocks(std::FILE* out, long long num_nodes, long long grain, BlockFn edges) {
+  WriteEdgeBlocks(out, num_nodes, grain, 0, (num_nodes + grain - 1) / grain, edges);
+}
+
+//Writes a graph straight from a generator that produces the edges of any block of sources on demand,
+//edges(begin, end, block, emit) calls emit(source, dest, cost). Pmed needs the edge count up front, so
+//the blocks are generated twice, once only counting. That relies on every block seeding its own engine.
+//With several ranks only this rank's slice of the blocks is written, and counted in the header.
+template <typename BlockFn>
+void StreamGraph(std::FILE* out, OutputFormat format, long long num_nodes, long long num_centers, long long grain, BlockFn edges) {
+  long long num_edges = 0;
+  if (format == kPmed) {
+    std::atomic<long long> count(0);
+    ParallelForSlice(num_nodes, grain, [&](long long begin, long long end, long long block) {
+      long long block_count = 0;
+      edges(begin, end, block, [&](long long, long long, long long) { block_count++; });
+      count += block_count;
+    });
+    num_edges = count;
+  }
+  WriteHeader(out, format, num_nodes, num_edges, num_centers);
+  auto blocks = RankBlocks((num_nodes + grain - 1) / grain);
+  WriteEdgeBlocks(out, num_nodes, grain, blocks.first, blocks.second, [&](long long begin, long long end, long long block, EdgeText& text) {
+    edges(begin, end, block, [&](long long source, long long dest, long long cost) { text.add(source, dest, cost); });
+  });
+}
@@ -1,5 +1,7 @@
 
 #pragma once
+//cxxopts uses std::numeric_limits without including it, GCC 12 no longer pulls it in otherwise
+#include <limits>
 #include "cxxopts.hpp"
 #include <iostream>
 #include <string> 
@@ -7,4 +9,35 @@
 #include <random>
 #include <utility>
 #include <cmath> 
-#include <set>
\ No newline at end of file
+#include <set>
+#include <vector>
+#include <list>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <chrono>
+#include <exception>
+#include <cstring>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <cerrno>
+#include <poll.h>
+#include <csignal>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
\ No newline at end of file
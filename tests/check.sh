@@ -0,0 +1,95 @@
+#!/bin/bash
+#Deterministic checks of a GraphGen build, run by ctest: usage check.sh <GraphGen binary> <scratch directory>
+#Every generator must give the same output with one and with several threads, and the same output materialized
+#and through --external. The skip-sampled generators must produce the edge count their probabilities give,
+#exactly at p=1 and within five standard deviations of the mean otherwise.
+graphgen=$1
+scratch=$2
+if [ -z "$graphgen" ] || [ -z "$scratch" ]; then
+  echo "usage: check.sh <GraphGen binary> <scratch directory>" >&2
+  exit 2
+fi
+mkdir -p "$scratch/external" || exit 2
+failed=0
+
+#expected degrees for configuration and equal Chung-Lu weights, so their expected edge count is known
+for ((i = 0; i < 20000; ++i)); do
+  echo $((2 + 2 * (i % 4)))
+done > "$scratch/degrees.txt"
+for ((i = 0; i < 20000; ++i)); do
+  echo 10
+done > "$scratch/weights.txt"
+
+cases=(
+  "-t random -n 20000 -p 0.005"
+  "-t random -n 20000 -p 0.005 -u --simple"
+  "-t csrandom -n 2000 -p 0.01"
+  "-t grid -n 40000 -p 0.9"
+  "-t geometric -n 20000 -p 0.005"
+  "-t chunglu -n 50000 -p 0.1 --chunglu_avg_degree 10"
+  "-t sbm -n 20000 -p 0.1 --sbm_sizes 10000,10000 --sbm_probs 0.001,0.0001;0.0001,0.001"
+  "-t smallworld -n 50000 -p 0.1 --smallworld_neighbours 5 -u"
+  "-t smallworld -n 50000 -p 0.1 --smallworld_neighbours 3"
+  "-t configuration -n 20000 -p 0.1 --configuration_degrees $scratch/degrees.txt --simple"
+  "-t regular -n 50000 -p 0.1 --regular_degree 6"
+  "-t scalefree -n 3000 -p 0.1"
+  "-t hyperbolic -n 50000 -p 0.1 --hyperbolic_avg_degree 10"
+  "-t lattice -n 40000 -p 0.9 --lattice_dims 200,200"
+  "-t planar -n 30000 -p 0.9"
+  "-t bipartite -n 20000 -p 0.001 --bipartite_no_isolated"
+  "-t holmekim -n 30000 -p 0.1"
+  "-t forestfire -n 30000 -p 0.1"
+  "-t copying -n 30000 -p 0.1"
+)
+
+for args in "${cases[@]}"; do
+  "$graphgen" $args -s 7 -f pajek --threads 1 > "$scratch/serial.txt" 2> "$scratch/error.txt" || {
+    echo "FAIL $args: $(cat "$scratch/error.txt")"
+    failed=1
+    continue
+  }
+  if ! "$graphgen" $args -s 7 -f pajek --threads 4 | cmp -s "$scratch/serial.txt" -; then
+    echo "FAIL $args: differs with --threads 4"
+    failed=1
+  fi
+  #csrandom keeps its edge set in memory and has no external mode
+  if [[ "$args" != *csrandom* ]] && ! "$graphgen" $args -s 7 -f pajek --external --external_memory 1 --external_dir "$scratch/external" 2> /dev/null | cmp -s "$scratch/serial.txt" -; then
+    echo "FAIL $args: differs with --external"
+    failed=1
+  fi
+done
+
+#expect_edges <expected> <tolerance> <args>, the count is read from the header of the pmed output. The
+#tolerances are five standard deviations of the binomial edge count.
+expect_edges() {
+  local expected=$1
+  local tolerance=$2
+  shift 2
+  local count
+  count=$("$graphgen" "$@" -s 7 -f pmed -k 1 | head -n 1 | cut -d ' ' -f 2)
+  if ! awk -v count="$count" -v expected="$expected" -v tolerance="$tolerance" 'BEGIN { exit !(count != "" && count >= expected - tolerance && count <= expected + tolerance) }'; then
+    echo "FAIL $*: $count edges, expected $expected +- $tolerance"
+    failed=1
+  fi
+}
+
+expect_edges 100 0 -t random -n 10 -p 1
+expect_edges 45 0 -t random -n 10 -p 1 -u
+expect_edges 20000 710 -t random -n 20000 -p 0.00005
+expect_edges 99995 1580 -t random -n 20000 -p 0.0005 -u
+expect_edges 360 0 -t grid -n 100 -p 1
+expect_edges 180 0 -t grid -n 100 -p 1 -u
+expect_edges 9900 352 -t grid -n 10000 -p 0.5 -u
+expect_edges 5400 0 -t lattice -n 1000 -p 1 --lattice_dims 10,10,10
+expect_edges 3000 0 -t lattice -n 1000 -p 1 --lattice_dims 10,10,10 -u --lattice_torus
+expect_edges 39700 705 -t lattice -n 20000 -p 0.5 --lattice_dims 100,200
+expect_edges 2500 0 -t bipartite -n 100 -p 1
+expect_edges 50000 1118 -t bipartite -n 20000 -p 0.0005
+expect_edges 4900 0 -t sbm -n 100 -p 0.1 --sbm_sizes 50,50 --sbm_probs "1,0;0,1"
+expect_edges 59995 1225 -t sbm -n 20000 -p 0.1 --sbm_sizes 10000,10000 --sbm_probs "0.0005,0.0001;0.0001,0.0005" -u
+expect_edges 99995 1580 -t chunglu -n 20000 -p 0.1 --chunglu_weights "$scratch/weights.txt"
+
+if [ $failed -eq 0 ]; then
+  echo "all checks passed"
+fi
+exit $failed